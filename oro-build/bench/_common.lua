@@ -0,0 +1,45 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Shared helpers for the microbenchmarks.
+--
+
+local function measure(fn, iterations)
+	iterations = iterations or 5
+
+	-- warm up
+	fn()
+
+	local best = math.huge
+	for _ = 1, iterations do
+		collectgarbage('collect')
+		local start = os.clock()
+		fn()
+		local elapsed = os.clock() - start
+		if elapsed < best then best = elapsed end
+	end
+
+	return best
+end
+
+local function compare(label, before, after)
+	io.stderr:write(string.format(
+		'%-32s before: %8.3fms   after: %8.3fms   (%.2fx)\n',
+		label,
+		before * 1000,
+		after * 1000,
+		before / after
+	))
+end
+
+return {
+	measure = measure,
+	compare = compare
+}
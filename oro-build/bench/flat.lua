@@ -0,0 +1,128 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Compares the original Lua `flat` iterator with
+-- the native one on a graph of ~100k edges.
+--
+
+local flat = require 'internal.util.flat'
+local Bench = require 'bench._common'
+
+-- The original (pure Lua) implementation.
+local function lua_isnuclear(v)
+	local meta = getmetatable(v)
+	return meta ~= nil and meta.__name ~= nil
+end
+
+local function lua_flat(t)
+	local stack = {{{t}, 1}}
+
+	local function iter(i)
+		local v = i[1][i[2]]
+		i[2] = i[2] + 1
+		return v
+	end
+
+	local nextv = nil
+	nextv = function()
+		local v = stack[#stack]
+		if v == nil then return end
+		v = iter(v)
+
+		while v == nil do
+			stack[#stack] = nil
+			v = stack[#stack]
+			if v == nil then return nil end
+			v = iter(v)
+		end
+
+		while type(v) == 'table' do
+			if lua_isnuclear(v) then break end
+
+			if #v == 0 then return nextv() end
+
+			local itr = {v, 1}
+			stack[#stack + 1] = itr
+			v = iter(itr)
+		end
+
+		if v == nil then return nextv() end
+
+		return v
+	end
+
+	return nextv
+end
+
+-- Build a graph shaped like typical rule invocations:
+-- nested lists of nuclear (Path-like) objects and strings.
+local Node = { __name = 'Node', __tostring = function(self) return self.path end }
+
+local function node(path)
+	return setmetatable({ path = path }, Node)
+end
+
+local builds = {}
+local edges = 0
+
+for i = 1, 20000 do
+	local opts = {
+		out = { node('out/' .. i .. '.o') },
+		node('src/' .. i .. '.c'),
+		{ node('include/' .. i .. '.h'), { node('include/common.h'), {} } },
+		'-DINDEX=' .. i,
+		in_implicit = { { node('gen/' .. i .. '.h') } }
+	}
+
+	builds[i] = opts
+	edges = edges + 6
+end
+
+-- Make sure the two agree (including on edge cases).
+local function collect(fn, t)
+	local r = {}
+	for v in fn(t) do r[#r + 1] = v end
+	return r
+end
+
+local cases = {
+	builds[1],
+	{},
+	{ {}, {{}}, 1, nil, 2 },
+	{ false, { false }, 'x' },
+	setmetatable({ 1, 2 }, { __len = function() return 1 end }),
+	42
+}
+
+for i, case in ipairs(cases) do
+	local a, b = collect(lua_flat, case), collect(flat, case)
+	assert(#a == #b, 'mismatched length for case #' .. i)
+	for j = 1, #a do
+		assert(a[j] == b[j], 'mismatched item #' .. j .. ' for case #' .. i)
+	end
+end
+
+local function run(fn)
+	return function()
+		local n = 0
+		for _, opts in ipairs(builds) do
+			for _ in fn(opts) do n = n + 1 end
+			for _ in fn(opts.out) do n = n + 1 end
+			for _ in fn(opts.in_implicit) do n = n + 1 end
+		end
+		assert(n == edges)
+	end
+end
+
+Bench.compare(
+	'flat (' .. tostring(edges) .. ' edges)',
+	Bench.measure(run(lua_flat)),
+	Bench.measure(run(flat))
+)
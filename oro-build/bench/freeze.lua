@@ -0,0 +1,210 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Compares the original (allocate-per-access) `freeze`
+-- with the memoized one, reading through frozen
+-- rule-like objects the way build scripts do.
+--
+
+local freeze = require 'internal.util.freeze'
+local iscallable = require 'internal.util.iscallable'
+local Bench = require 'bench._common'
+
+-- The original implementation.
+local old = {}
+do
+	local freeze = nil
+
+	local function unfreeze(obj)
+		local mt = getmetatable(obj)
+		if type(mt) == 'table' and mt.__frozen then
+			return debug.getmetatable(obj).__this
+		end
+
+		return obj
+	end
+
+	-- You can pass a function that receives (k,v) to
+	-- newindex, or simply pass `true` to forward writes
+	-- to the underlying handler.
+	--
+	-- Why use freeze() in such a case? Since it correctly
+	-- masks the metatable, and also prevents rawset()
+	-- in scripting contexts.
+	function freeze(obj, newindex)
+		if obj == nil then return nil end
+
+		local objt = type(obj)
+		if objt == 'function' then
+			return function (this, ...)
+				this = unfreeze(this)
+				return obj(this, ...)
+			end
+		end
+
+		if objt ~= 'table' and objt ~= 'userdata' then
+			return obj
+		end
+
+		local omt = getmetatable(obj)
+		if type(omt) ~= 'table' then omt = nil end
+
+		-- don't create nested frozen objects
+		if omt and omt.__frozen then return obj end
+
+		local proxy = {}
+
+		local mt = {
+			__this = obj,
+			__index = function(_, k)
+				return freeze(obj[k])
+			end,
+			__newindex = function()
+				error('cannot modify frozen object', 2)
+			end,
+			__tostring = function ()
+				return tostring(obj)
+			end,
+			__pairs = function()
+				local obj_next = pairs(obj)
+
+				local function protected_next(this, key)
+					local k, v = obj_next(obj, unfreeze(key))
+					return freeze(k), freeze(v)
+				end
+
+				return protected_next, proxy, nil
+			end,
+			__eq = function(_, y)
+				return obj == unfreeze(y)
+			end,
+			__len = function()
+				return freeze(#obj)
+			end
+		}
+
+		-- some callers might want to allow assigning new values
+		-- so switch out __newindex if that's the case
+		if newindex == true then
+			mt.__newindex = function(_, k, v)
+				if iscallable(omt.__newindex) then
+					omt.__newindex(obj, k, v)
+				elseif type(omt.__newindex) == 'table' then
+					omt.__newindex[k] = v
+				end
+			end
+		elseif newindex then
+			mt.__newindex = function(_, ...)
+				return newindex(...)
+			end
+		end
+
+		local callable = false
+		if iscallable(obj) then
+			mt.__call = function(_, this, ...)
+				this = unfreeze(this)
+				return obj(this, ...)
+			end
+
+			callable = true
+		end
+
+		local name = nil
+		if omt then name = omt.__name end
+
+		mt.__metatable = setmetatable({}, {
+			__index = function(_, k)
+				if k == '__frozen' then return true end
+				if k == '__name' then return name end
+				-- used by iscallable() to check callability of frozen objects
+				-- without needing to unfreeze them (since we also depend on
+				-- iscallable)
+				if k == '__callable' then return callable end
+				error('attempt to index a frozen object\'s metatable', 2)
+			end,
+			__newindex = function()
+				error('attempt to assign to a frozen object\'s metatable', 2)
+			end
+		})
+
+		return setmetatable(proxy, mt)
+	end
+
+	old.freeze = freeze
+end
+
+-- A "configuration" of rule objects, each with
+-- options and a couple of methods.
+local Rule = {
+	__name = 'Rule',
+	__index = {
+		command = function(self) return self.options.command end
+	}
+}
+
+local objects = {}
+for i = 1, 5000 do
+	objects[i] = setmetatable({
+		options = {
+			command = { 'cc', '-c', '$in', '-o', '$out' },
+			description = 'CC ' .. i,
+			depfile = '$out.d'
+		},
+		outputs = { 'out/' .. i .. '.o' }
+	}, Rule)
+end
+
+local function run(freeze)
+	local frozen = {}
+	for i, obj in ipairs(objects) do
+		frozen[i] = freeze(obj)
+	end
+
+	return function()
+		local n = 0
+		for _ = 1, 10 do
+			for _, f in ipairs(frozen) do
+				n = n + #f.options.command
+				n = n + #f:command()
+				for _ in pairs(f.options) do
+					n = n + 1
+				end
+				if f.outputs[1] ~= nil then n = n + 1 end
+			end
+		end
+		return n
+	end
+end
+
+local function allocated(fn)
+	collectgarbage('collect')
+	collectgarbage('stop')
+	local before = collectgarbage('count')
+	fn()
+	local after = collectgarbage('count')
+	collectgarbage('restart')
+	return after - before
+end
+
+local before_fn, after_fn = run(old.freeze), run(freeze)
+assert(before_fn() == after_fn())
+
+io.stderr:write(string.format(
+	'%-32s before: %8.0fKiB   after: %8.0fKiB\n',
+	'freeze (allocated)',
+	allocated(before_fn),
+	allocated(after_fn)
+))
+
+Bench.compare(
+	'freeze (read-heavy)',
+	Bench.measure(before_fn),
+	Bench.measure(after_fn)
+)
@@ -0,0 +1,46 @@
+#!/usr/bin/env bash
+
+#  __   __   __
+# /  \ |__) /  \
+# \__/ |  \ \__/
+#
+# ORO BUILD GENERATOR
+# Copyright (c) 2021-2022, Josh Junon
+# License TBD
+#
+
+#
+# Runs the harness microbenchmarks.
+#
+# Each benchmark is a Lua script that's run as the
+# harness's bootstrap script (in place of oro-build.lua)
+# so that it has access to the native functions, or
+# a shell script that's given the harness as $HARNESS.
+#
+# usage: bench/run.sh [<name>...]
+#
+
+set -euo pipefail
+cd "$(dirname "$0")"
+
+BIN_DIR="bin"
+HARNESS="$BIN_DIR/.oro/build"
+
+mkdir -p "$BIN_DIR/.oro"
+
+if [ ! -f "$HARNESS" ] || [ ../oro-build.c -nt "$HARNESS" ]; then
+	"${CC-cc}" -o "$HARNESS" -O3 -g0 -DMAKE_LIB=1 -DLUA_ANSI=1 -Wall -Wextra -Werror -I../ext/lua ../oro-build.c -lm
+fi
+
+if [ $# -eq 0 ]; then
+	set -- $(ls *.lua *.sh | grep -v '^_' | grep -v '^run\.sh$' | sed 's/\.\(lua\|sh\)$//')
+fi
+
+for name in "$@"; do
+	printf -- '----------- \x1b[95;1m%s\x1b[m -----------\n' "$name" >&2
+	if [ -f "$name.sh" ]; then
+		HARNESS="$PWD/$HARNESS" BIN_DIR="$PWD/$BIN_DIR" bash "$name.sh"
+	else
+		"$HARNESS" .. "$BIN_DIR" "$name.lua" "$name.lua"
+	fi
+done
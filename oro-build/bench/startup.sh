@@ -0,0 +1,56 @@
+#!/usr/bin/env bash
+
+#  __   __   __
+# /  \ |__) /  \
+# \__/ |  \ \__/
+#
+# ORO BUILD GENERATOR
+# Copyright (c) 2021-2022, Josh Junon
+# License TBD
+#
+
+#
+# Per-operation cost of `--syscall`: one process per
+# operation (as with one Ninja edge per operation)
+# versus a single `--syscall batch` process.
+#
+# Run via bench/run.sh (which sets $HARNESS and $BIN_DIR).
+#
+
+set -euo pipefail
+
+COUNT="${COUNT-500}"
+WORK="$BIN_DIR/startup"
+
+rm -rf "$WORK"
+mkdir -p "$WORK"
+cd "$WORK"
+
+now() { date +%s%N; }
+
+rsp="ops.rsp"
+: > "$rsp"
+for i in $(seq 1 "$COUNT"); do
+	echo "touch t$i" >> "$rsp"
+done
+
+# warm up
+"$HARNESS" --syscall batch "$rsp"
+
+start=$(now)
+for i in $(seq 1 "$COUNT"); do
+	"$HARNESS" --syscall touch "t$i"
+done
+before=$(( $(now) - start ))
+
+start=$(now)
+"$HARNESS" --syscall batch "$rsp"
+after=$(( $(now) - start ))
+
+awk -v label="touch x$COUNT (spawn vs. batch)" -v b="$before" -v a="$after" 'BEGIN {
+	printf "%-32s before: %8.3fms   after: %8.3fms   (%.2fx)\n", label, b / 1e6, a / 1e6, b / a
+}' >&2
+
+awk -v b="$before" -v n="$COUNT" 'BEGIN {
+	printf "%-32s %8.3fus per spawn\n", "syscall startup", b / n / 1e3
+}' >&2
@@ -25,6 +25,9 @@ local P = require 'internal.path'
 local freeze = require 'internal.util.freeze'
 local Ninjafile = require 'internal.ninja'
 local typename = require 'internal.util.typename'
+local ScriptCache = require 'internal.script-cache'
+local ModuleCache = require 'internal.module-cache'
+local Profile = require 'internal.profile'
 
 local Context = {}
 local Module = {}
@@ -37,7 +40,15 @@ local function make_module(opts)
 			context = opts.context or error 'missing opts.context',
 			env = opts.env or error 'missing opts.env',
 			config = opts.config or error 'missing opts.config',
-			exports = {all = List()}
+			-- The module's script (if any) and the module
+			-- whose config/env it inherits (if not the root's)
+			pathname = opts.pathname,
+			parent = opts.parent,
+			exports = {all = List()},
+			-- (see Context:makephony())
+			tags = 0,
+			-- (see oro-build.lua)
+			ninja = Ninjafile(opts.context.ninja)
 		},
 		{
 			__index = Module,
@@ -85,9 +96,12 @@ local function make_context(opts)
 			modules = {},
 			rules = List(),
 			rulemap = {},
+			rulekeys = {},
+			ruleids = {},
 			builds = List(),
 			ninja = Ninjafile(),
-			tags = 0
+			-- (see oro.shared)
+			shared = {}
 		},
 		{
 			__index = Context,
@@ -106,15 +120,16 @@ local function make_context(opts)
 		root = ctx.root,
 		build_root = ctx.build_root,
 		context = ctx,
+		pathname = opts.build_script or error 'missing opts.build_script',
 		env = setmetatable({}, {
 			__index = function (_, k)
-				return ctx.env[k]
+				return ctx.root_module:inherit('env', k, ctx.env[k])
 			end
 		}),
 		config = setmetatable({}, {
 			__index = function (_, k)
 				ctx.referenced_config[k] = true
-				return ctx.config[k]
+				return ctx.root_module:inherit('config', k, ctx.config[k])
 			end
 		})
 	}
@@ -149,6 +164,7 @@ function Context:setenv(name, value)
 	end
 
 	self.current_module.env[name] = value
+	self.current_module:log('setenv', name, value)
 end
 
 function Context:getconfig(name)
@@ -164,6 +180,7 @@ function Context:setconfig(name, value)
 	end
 
 	self.current_module.config[name] = value
+	self.current_module:log('setconfig', name, value)
 end
 
 function Context:export(name, value)
@@ -178,6 +195,7 @@ function Context:export(name, value)
 	end
 
 	self.current_module.exports[name] = value
+	self.current_module.sig = nil
 end
 
 function Context:getexport(name)
@@ -197,6 +215,43 @@ function Context:print(...)
 	print(...)
 end
 
+-- Creates the module for the local script at `pathname`,
+-- which inherits its config/env from `parent` (the module
+-- that imported it first).
+function Context:makelocal(pathname, parent)
+	local source_root = P.dirname(pathname)
+
+	local module = nil
+	module = make_module {
+		root = source_root,
+		build_root = P.normalize(
+			P.join(
+				self.build_root,
+				P.relpath(
+					self.root,
+					source_root
+				)
+			)
+		),
+		context = self,
+		pathname = pathname,
+		parent = parent,
+		config = setmetatable({}, {
+			__index = function (_, k)
+				return module:inherit('config', k, parent.config[k])
+			end
+		}),
+		env = setmetatable({}, {
+			__index = function (_, k)
+				return module:inherit('env', k, parent.env[k])
+			end
+		})
+	}
+
+	self.modules[pathname] = module
+	return module
+end
+
 function Context:importlocal(import, opts)
 	assert(self.current_module ~= nil)
 
@@ -221,41 +276,75 @@ function Context:importlocal(import, opts)
 
 	local module = self.modules[pathname]
 
-	local source_root = P.dirname(pathname)
+	local importer = self.current_module
+	if module == nil then
+		module = self:makelocal(pathname, importer)
+
+		Profile.begin('import ' .. tostring(import), 'importlocal')
+		module:load(pathname)
+		Profile.finish()
+	end
+
+	if importer.record ~= nil then
+		importer:log('import', pathname, module:signature())
+	end
+
+	return module:result()
+end
+
+-- Evaluates the standard library module at `pathname`
+-- (once)
+function Context:loadstd(pathname, import)
+	local module = self.modules[pathname]
 
-	local this = self
-	local parent_module = self.current_module
 	if module == nil then
+		local libdir = P.join(Oro.absrootdir, 'lib')
+		local source_root = P.dirname(pathname)
+
+		local this = self
 		module = make_module {
 			root = source_root,
 			build_root = P.normalize(
 				P.join(
-					self.build_root,
+					P.join(self.build_root, '.oro/lib'),
 					P.relpath(
-						self.root,
+						libdir,
 						source_root
 					)
 				)
 			),
 			context = self,
+			pathname = pathname,
+			-- Standard libraries pull from the 'global' config/env
+			-- when executing the top level. Exported functions are
+			-- still executed in whichever context they're invoked from.
+			--
+			-- This is to prevent side-effects or strange behavior based
+			-- on order-of-imports changes or unruly dependencies.
 			config = setmetatable({}, {
 				__index = function (_, k)
-					return parent_module.config[k]
+					this.referenced_config[k] = true
+					return this.config[k]
 				end
 			}),
 			env = setmetatable({}, {
 				__index = function (_, k)
-					return parent_module.env[k]
+					return this.env[k]
 				end
 			})
 		}
 
+		-- The standard modules it imports (see Context:stdclosure())
+		module.stdimports = {}
+
 		self.modules[pathname] = module
 
+		Profile.begin('import ' .. tostring(import or pathname), 'importstd')
 		module:dofile(pathname)
+		Profile.finish()
 	end
 
-	return module:result()
+	return module
 end
 
 function Context:importstd(import, opts)
@@ -280,61 +369,147 @@ function Context:importstd(import, opts)
 		)
 	end
 
-	local module = self.modules[pathname]
+	local importer = self.current_module
+	local module = self:loadstd(pathname, import)
 
-	local source_root = P.dirname(pathname)
+	if importer.stdimports ~= nil then
+		importer.stdimports[pathname] = true
+	end
 
-	local this = self
-	if module == nil then
-		module = make_module {
-			root = source_root,
-			build_root = P.normalize(
-				P.join(
-					P.join(self.build_root, '.oro/lib'),
-					P.relpath(
-						libdir,
-						source_root
-					)
-				)
-			),
-			context = self,
-			-- Standard libraries pull from the 'global' config/env
-			-- when executing the top level. Exported functions are
-			-- still executed in whichever context they're invoked from.
-			--
-			-- This is to prevent side-effects or strange behavior based
-			-- on order-of-imports changes or unruly dependencies.
-			config = setmetatable({}, {
-				__index = function (_, k)
-					this.referenced_config[k] = true
-					return this.config[k]
-				end
-			}),
-			env = setmetatable({}, {
-				__index = function (_, k)
-					return this.env[k]
-				end
-			})
-		}
+	if importer.record ~= nil then
+		importer:log('std', pathname, self:stdclosure(pathname))
+	end
 
-		self.modules[pathname] = module
+	return module:result()
+end
 
-		module:dofile(pathname)
+-- The contents hashes of a standard library module
+-- and those it imports (recursively), by path
+function Context:stdclosure(pathname, closure)
+	closure = closure or {}
+
+	if closure[pathname] == nil then
+		closure[pathname] = ModuleCache.filehash(pathname) or ''
+		for dep, _ in pairs(self.modules[pathname].stdimports) do
+			self:stdclosure(dep, closure)
+		end
 	end
 
-	return module:result()
+	return closure
+end
+
+local function sharedkey(key, level)
+	local serialized = key ~= nil and ModuleCache.serialize(key)
+	if not serialized then
+		error('oro.shared keys must be strings, numbers, booleans or Paths; got ' .. typename(key), level + 1)
+	end
+	return serialized
+end
+
+function Context:sharedtable(name)
+	local tbl = self.shared[name]
+	if tbl == nil then
+		tbl = {}
+		self.shared[name] = tbl
+	end
+	return tbl
+end
+
+-- Shared tables are keyed by the entries' serialized
+-- keys, which the module cache records reads and writes
+-- by (see internal.module-cache).
+function Context:getshared(name, key)
+	assert(self.current_module ~= nil)
+
+	local serialized = sharedkey(key, 3)
+	local value = self:sharedtable(name)[serialized]
+
+	if self.current_module.record ~= nil then
+		self.current_module:log('sharedread', name, serialized, ModuleCache.serialize(value))
+	end
+
+	return value
+end
+
+function Context:setshared(name, key, value)
+	assert(self.current_module ~= nil)
+
+	local serialized = sharedkey(key, 3)
+	self:sharedtable(name)[serialized] = value
+	self.current_module:log('sharedwrite', name, serialized, value)
 end
 
+-- Built-in pools (i.e. `console`) aren't declared
+function Context:definepool(pool)
+	if pool ~= nil and not pool.builtin then
+		self.ninja:add_pool(pool.name, pool.depth)
+	end
+end
+
+-- The canonical form of a rule's (flattened) options
+local function rulekey(options)
+	local keys = {}
+	for k, _ in pairs(options) do
+		keys[#keys + 1] = k
+	end
+	table.sort(keys)
+
+	local parts = {}
+	for _, k in ipairs(keys) do
+		local v = options[k]
+		parts[#parts + 1] = k
+		if type(v) == 'table' then
+			-- lists are escaped when written; strings aren't
+			parts[#parts + 1] = '\1'
+			for _, item in ipairs(v) do
+				-- (Paths are interned and have a stable string form)
+				parts[#parts + 1] = tostring(item)
+			end
+		else
+			parts[#parts + 1] = '\2' .. tostring(v)
+		end
+	end
+
+	return table.concat(parts, '\0')
+end
+
+-- Rules are interned by their options, so that identical
+-- rules (clones, or the same Rule{} in several modules)
+-- share a single Ninja rule.
 function Context:definerule(rule)
 	if self.rulemap[rule] == nil then
-		local id = tostring(#self.rules)
-		self.rules[nil] = rule
-		self.rulemap[rule] = id
+		local key = rulekey(rule.options)
+		local id = self.rulekeys[key]
+
+		-- (also checks for conflicting pool depths)
+		self:definepool(rule.pool)
+
+		if id == nil then
+			-- Rules are named by their options rather than by the
+			-- order they're defined in, so that a module's builds
+			-- keep their rules' names whichever other modules are
+			-- evaluated (or replayed; see internal.module-cache).
+			local hash = Oro.hashstring(key):sub(1, 8)
+			local n = 0
+			id = hash
+			while self.ruleids[id] ~= nil do
+				n = n + 1
+				id = hash .. '_' .. tostring(n)
+			end
 
-		self.ninja:add_rule(
-			'R'..id,
-			rule.options
-		)
+			self.ruleids[id] = true
+			self.rules[nil] = rule
+			self.rulekeys[key] = id
+			Profile.count(self.current_module, 'rules')
+
+			self.ninja:add_rule(
+				'R'..id,
+				rule.options
+			)
+		end
+
+		self.rulemap[rule] = id
+		self.current_module:log('rule', rule)
 	end
 end
 
@@ -345,14 +520,22 @@ function Context:definebuild(build)
 
 	self.builds[nil] = build
 
-	self.ninja:add_build(
+	self:definepool(build.pool)
+
+	-- Builds are written to their module's own Ninja file
+	local module = self.current_module
+	assert(module ~= nil)
+	module.ninja:add_build(
 		'R'..ruleid,
 		build.options
 	)
+	Profile.count(module, 'builds')
+
+	module:log('build', build.rule, build.options, build.pool)
 
 	if not build.options.exclude then
-		assert(self.current_module ~= nil)
-		self.current_module.exports.all[nil] = {build.options.out, build.options.out_implicit}
+		module.exports.all[nil] = {build.options.out, build.options.out_implicit}
+		module.sig = nil
 	end
 end
 
@@ -363,22 +546,37 @@ local phony_proxy_rule = {
 	}
 }
 
-function Context:makephony(arguments, deps)
+-- `pool` (if any) is a Pool, e.g. Pool.console for
+-- interactive commands.
+function Context:makephony(arguments, deps, pool)
 	assert(self.current_module ~= nil)
 
 	self:definerule(phony_proxy_rule)
 
-	local tagid = self.tags
-	self.tags = self.tags + 1
+	-- Tags are numbered by module (and named after its script,
+	-- unless that's a build.oro), so that they don't depend on
+	-- the order modules are evaluated in.
+	local module = self.current_module
+	local tagid = module.tags
+	module.tags = module.tags + 1
+
+	local prefix = 'PHONY.'
+	local script = P.basename(module.pathname)
+	if script ~= 'build.oro' then
+		prefix = prefix .. P.splitext(script) .. '.'
+	end
+
 	-- We cheat a bit here. But it works.
-	local tagpath = self.script_globals.B('PHONY.' .. tostring(tagid))
+	local tagpath = self.script_globals.B(prefix .. tostring(tagid))
 
 	self:definebuild {
 		rule = phony_proxy_rule,
+		pool = pool,
 		options = {
 			in_implicit = {deps},
 			command = {arguments},
 			out_implicit = {tagpath},
+			pool = pool and {pool.name},
 			exclude = true
 		}
 	}
@@ -386,6 +584,86 @@ function Context:makephony(arguments, deps)
 	return freeze({tagpath})
 end
 
+-- Whether the cached evaluation (`record`) of the script
+-- at `pathname` can be replayed instead of evaluating it:
+-- the script, the standard libraries it used and the
+-- harness must be unchanged, and so must everything it
+-- read from outside of itself (as of the same point in the
+-- evaluation). `inherited(kind, k)` returns the (serialized)
+-- config/env value the module would inherit.
+--
+-- Imports of modules that aren't loaded yet are checked
+-- (recursively) against the importer's view; `state` holds
+-- those (`pending`, by path) and the `oro.shared` writes
+-- replaying them would make (`shared`).
+function Context:canreplay(record, pathname, inherited, state)
+	if record.script ~= ModuleCache.filehash(pathname) then
+		return false
+	end
+
+	local own = { config = {}, env = {} }
+	local function view(kind, k)
+		local v = own[kind][k]
+		if v ~= nil then return v end
+		return inherited(kind, k)
+	end
+
+	for _, event in ipairs(record.log) do
+		local kind = event[1]
+
+		if kind == 'config' or kind == 'env' then
+			if inherited(kind, event[2]) ~= event[3] then
+				return false
+			end
+		elseif kind == 'setconfig' or kind == 'setenv' then
+			local v = event[3]
+			if v == 'nil' then v = nil end
+			own[kind == 'setconfig' and 'config' or 'env'][event[2]] = v
+		elseif kind == 'import' then
+			local child = event[2]
+			local sig = nil
+
+			local module = self.modules[child]
+			if module ~= nil then
+				sig = module:signature()
+			elseif state.pending[child] ~= nil then
+				sig = state.pending[child].sig
+			else
+				local childrecord = ModuleCache.load(child)
+				if childrecord == nil or not self:canreplay(childrecord, child, view, state) then
+					return false
+				end
+
+				state.pending[child] = childrecord
+				sig = childrecord.sig
+			end
+
+			if sig ~= event[3] then
+				return false
+			end
+		elseif kind == 'std' then
+			for path, hash in pairs(event[3]) do
+				if (ModuleCache.filehash(path) or '') ~= hash then
+					return false
+				end
+			end
+		elseif kind == 'sharedread' then
+			local v = state.shared[event[2] .. '\0' .. event[3]]
+			if v == nil then
+				v = ModuleCache.serialize(self:sharedtable(event[2])[event[3]])
+			end
+
+			if v ~= event[4] then
+				return false
+			end
+		elseif kind == 'sharedwrite' then
+			state.shared[event[2] .. '\0' .. event[3]] = event[4]
+		end
+	end
+
+	return true
+end
+
 function Context:makesourcepath(...)
 	assert(self.current_module ~= nil)
 	return self.current_module.source_factory(...)
@@ -396,15 +674,156 @@ function Context:makebuildpath(...)
 	return self.current_module.build_factory(...)
 end
 
+-- Records an event of the module's evaluation (if it's
+-- being recorded; see internal.module-cache)
+function Module:log(...)
+	local record = self.record
+	if record ~= nil then
+		record.log[#record.log + 1] = {...}
+	end
+end
+
+-- Reads of inherited config/env values are inputs to the
+-- module's evaluation (see Context:canreplay()).
+function Module:inherit(kind, k, v)
+	local record = self.record
+	if record ~= nil and k ~= nil and not record.inherited[kind][k] then
+		record.inherited[kind][k] = true
+		self:log(kind, k, ModuleCache.serialize(v))
+	end
+
+	return v
+end
+
+-- The config/env value the module inherits, without
+-- recording (or marking) the read
+function Module:inherited(kind, k)
+	if self.parent ~= nil then
+		return self.parent:peek(kind, k)
+	end
+
+	return self.context[kind][k]
+end
+
+function Module:peek(kind, k)
+	local v = rawget(self[kind], k)
+	if v ~= nil then return v end
+	return self:inherited(kind, k)
+end
+
+-- A hash of the module's exports and default export, as
+-- seen by its importers (nil if they can't be serialized)
+function Module:signature()
+	if self.sig == nil then
+		local serialized = ModuleCache.serialize({self.exports, self.default_export})
+		self.sig = serialized ~= nil and Oro.hashstring(serialized) or false
+	end
+
+	return self.sig or nil
+end
+
+-- Evaluates a local (or the root) module's script, or
+-- replays its cached evaluation if nothing it depends on
+-- changed (see internal.module-cache).
+function Module:load(pathname)
+	if ModuleCache.enabled then
+		local record = ModuleCache.load(pathname)
+
+		local function inherited(kind, k)
+			return ModuleCache.serialize(self:inherited(kind, k))
+		end
+
+		if
+			record ~= nil
+			and self.context:canreplay(record, pathname, inherited, { pending = {}, shared = {} })
+		then
+			self:replay(record)
+			return
+		end
+	end
+
+	self.record = ModuleCache.start(pathname)
+	self:dofile(pathname)
+	ModuleCache.save(self)
+	self.record = nil
+end
+
+-- Re-applies a module's recorded evaluation, along with
+-- those of the local modules it imported first (which
+-- Context:canreplay() checked along with it).
+function Module:replay(record)
+	local ctx = self.context
+
+	local rules = {}
+	local function rule(index)
+		local r = rules[index]
+		if r == nil then
+			r = { options = record.rules[index][1], pool = record.rules[index][2] }
+			rules[index] = r
+		end
+
+		ctx:definerule(r)
+		return r
+	end
+
+	Profile.begin(Profile.label(self.pathname), 'replay', self)
+	local previous_module = ctx:setcontext(self)
+
+	for _, event in ipairs(record.log) do
+		local kind = event[1]
+
+		if kind == 'config' or kind == 'env' then
+			-- (e.g. marks command line config as referenced)
+			local _ = self[kind][event[2]]
+		elseif kind == 'setconfig' then
+			self.config[event[2]] = ModuleCache.deserialize(event[3])
+		elseif kind == 'setenv' then
+			self.env[event[2]] = ModuleCache.deserialize(event[3])
+		elseif kind == 'rule' then
+			rule(event[2])
+		elseif kind == 'build' then
+			ctx:definebuild {
+				rule = rule(event[2]),
+				options = event[3],
+				pool = event[4]
+			}
+		elseif kind == 'childexport' then
+			local module = ctx.modules[event[2]]
+			module.exports[event[3]] = event[4]
+			module.sig = nil
+		elseif kind == 'import' then
+			if ctx.modules[event[2]] == nil then
+				local module = ctx:makelocal(event[2], self)
+				module:replay(ModuleCache.load(event[2]))
+			end
+		elseif kind == 'std' then
+			ctx:loadstd(event[2])
+		elseif kind == 'sharedwrite' then
+			ctx:sharedtable(event[2])[event[3]] = ModuleCache.deserialize(event[4])
+		end
+	end
+
+	ctx:setcontext(previous_module)
+	Profile.finish()
+
+	self.exports = record.exports
+	self.default_export = record.default
+	self.sig = nil
+
+	ModuleCache.replayed()
+end
+
 function Module:dofile(pathname)
 	assert(P.isabs(pathname), 'must be absolute: ' .. tostring(pathname))
 
-	local chunk, err = loadfile(pathname, 'bt', self.context.script_globals)
+	local chunk, err = ScriptCache.load(pathname, self.context.script_globals)
 	assert(chunk ~= nil, err)
 
+	Profile.begin(Profile.label(pathname), 'script', self)
 	local previous_module = self.context:setcontext(self)
 	local rets = {chunk()}
 	self.context:setcontext(previous_module)
+	Profile.finish()
 
 	if #rets == 1 then
 		self.default_export = rets[1]
@@ -451,6 +870,8 @@ function Module:result()
 				error('cannot override child \'all\' export', 3)
 			end
 			self.exports[k] = v
+			self.sig = nil
+			self.context.current_module:log('childexport', self.pathname, k, v)
 		end,
 		__name = 'ModuleResult'
 	})
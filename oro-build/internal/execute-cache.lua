@@ -0,0 +1,211 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Persistent cache for `oro.execute{cache=true, ...}`
+-- results (e.g. compiler probes), kept across
+-- re-configurations in `<bin_dir>/.oro/execute-cache.lua`.
+--
+-- Entries are keyed by the argument list, the explicit
+-- `env` table (if any), `stdin`, and the identity of the
+-- resolved executable (device, inode, size and times), so
+-- upgrading or replacing a tool invalidates its results.
+-- The same goes for any later argument that names an
+-- executable (e.g. the compiler behind `ccache gcc`).
+--
+-- Commands without an `env` table inherit ours; of that,
+-- the variables that commonly change a tool's output (see
+-- `INHERITED` below) are keyed too, along with any named
+-- by the command's `cacheenv` list.
+--
+-- Only entries that were used during a configuration
+-- are written back, so stale entries fall out on their own
+-- (unless modules were replayed from the module cache,
+-- whose commands didn't run).
+--
+
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
+local lfs = require 'lfs'
+
+local cachepath = P.join(Oro.absbindir, '.oro/execute-cache.lua')
+
+-- Inherited variables keyed for commands without `env`
+-- (in addition to `LC_*`)
+local INHERITED = {
+	'PATH', 'LANG', 'LANGUAGE', 'TMPDIR',
+	'CC', 'CXX', 'CPP', 'AR', 'LD',
+	'CFLAGS', 'CXXFLAGS', 'CPPFLAGS', 'LDFLAGS',
+	'CPATH', 'C_INCLUDE_PATH', 'CPLUS_INCLUDE_PATH', 'LIBRARY_PATH',
+	'GCC_EXEC_PREFIX', 'COMPILER_PATH', 'SDKROOT',
+	'PKG_CONFIG_PATH', 'PKG_CONFIG_LIBDIR', 'PKG_CONFIG_SYSROOT_DIR'
+}
+
+local entries = {}
+local used = {}
+local dirty = false
+
+do
+	local chunk = loadfile(cachepath, 't', {})
+	if chunk ~= nil then
+		local ok, res = pcall(chunk)
+		if ok and type(res) == 'table' then
+			entries = res
+		end
+	end
+end
+
+-- If `strict`, returns nil unless `exe` resolves to an
+-- executable file (rather than e.g. an input path)
+local function identity(exe, pathenv, strict)
+	local resolved = Oro.searchpath(exe, pathenv)
+	if resolved == nil then return nil end
+
+	local attrs = lfs.attributes(resolved)
+	if attrs == nil then return nil end
+
+	if
+		strict
+		and (
+			attrs.mode ~= 'file'
+			or not string.find(attrs.permissions or '', 'x', 1, true)
+		)
+	then
+		return nil
+	end
+
+	return table.concat(
+		{
+			resolved,
+			tostring(attrs.dev),
+			tostring(attrs.ino),
+			tostring(attrs.size),
+			tostring(attrs.modification),
+			tostring(attrs.change)
+		},
+		':'
+	)
+end
+
+local function makekey(opts)
+	local pathenv = (opts.env and opts.env.PATH) or Oro.env.PATH or ''
+
+	local exeid = identity(tostring(opts[1]), pathenv)
+	if exeid == nil then return nil end
+
+	local parts = { exeid }
+
+	-- Launchers (e.g. `ccache`, `env`) run later arguments
+	for i = 2, #opts do
+		local arg = tostring(opts[i])
+		parts[#parts + 1] = arg
+
+		local argid = identity(arg, pathenv, true)
+		if argid ~= nil then
+			parts[#parts + 1] = '\0exe' .. argid
+		end
+	end
+
+	parts[#parts + 1] = '\0env'
+	local envparts = {}
+	if opts.env ~= nil then
+		for k, v in pairs(opts.env) do
+			envparts[#envparts + 1] = tostring(k) .. '=' .. tostring(v)
+		end
+	else
+		local names = {}
+		for _, k in ipairs(INHERITED) do names[k] = true end
+		for _, k in ipairs(opts.cacheenv or {}) do names[tostring(k)] = true end
+		for k, _ in pairs(Oro.env) do
+			if string.sub(k, 1, 3) == 'LC_' then names[k] = true end
+		end
+
+		for k, _ in pairs(names) do
+			if Oro.env[k] ~= nil then
+				envparts[#envparts + 1] = k .. '=' .. Oro.env[k]
+			end
+		end
+	end
+	table.sort(envparts)
+	parts[#parts + 1] = table.concat(envparts, '\0')
+
+	parts[#parts + 1] = '\0stdin'
+	if opts.stdin ~= nil then
+		parts[#parts + 1] = tostring(opts.stdin)
+	end
+
+	return table.concat(parts, '\0')
+end
+
+local function execute(opts)
+	if type(opts) ~= 'table' or not opts.cache then
+		return Oro.execute(opts)
+	end
+
+	local key = makekey(opts)
+	if key == nil then
+		-- Let the harness report the failure.
+		return Oro.execute(opts)
+	end
+
+	local entry = used[key] or entries[key]
+
+	-- Failed results that should raise are re-run so that
+	-- the error reflects the real (current) invocation.
+	if entry ~= nil and (entry[1] == 0 or opts.raise == false) then
+		used[key] = entry
+		return entry[1], entry[2], entry[3]
+	end
+
+	local status, stdout, stderr = Oro.execute(opts)
+	used[key] = { status, stdout, stderr }
+	dirty = true
+
+	return status, stdout, stderr
+end
+
+-- Drops unused entries if `prune`
+local function save(prune)
+	if not prune then
+		for k, v in pairs(entries) do
+			if used[k] == nil then
+				used[k] = v
+			end
+		end
+	end
+
+	-- Also rewrite when entries were dropped
+	if not dirty then
+		for k, _ in pairs(entries) do
+			if used[k] == nil then
+				dirty = true
+				break
+			end
+		end
+	end
+
+	if not dirty then return end
+
+	local tmppath = cachepath .. '.tmp'
+	local stream = assert(io.open(tmppath, 'wb'))
+
+	stream:write('return {\n')
+	for k, v in pairs(used) do
+		stream:write(string.format('[%q]={%d,%q,%q},\n', k, v[1], v[2], v[3]))
+	end
+	stream:write('}\n')
+	stream:close()
+
+	assert(os.rename(tmppath, cachepath))
+end
+
+return {
+	execute = execute,
+	save = save
+}
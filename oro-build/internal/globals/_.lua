@@ -117,7 +117,8 @@ local function make_globals(cb)
 
 	oro.List = List
 	oro.Set = Set
-	oro.execute = Oro.execute
+	oro.execute = (require 'internal.execute-cache').execute
+	oro.executemany = Oro.executemany
 
 	oro.syscall = require 'internal.globals.syscall'
 
@@ -139,6 +140,40 @@ local function make_globals(cb)
 	assert(iscallable(cb.makephony), 'missing callback: makephony')
 	oro.phony = make_phony_factory(function (...) return cb:makephony(...) end)
 
+	-- Tables shared by every module, e.g. for libraries
+	-- that define a build once for all of its users. Keys
+	-- must be strings, numbers, booleans or Paths.
+	--
+	-- Unlike library upvalues, reads and writes are seen
+	-- by the module cache (see internal.module-cache), so
+	-- modules replayed from it still find (and provide)
+	-- the entries they did when evaluated.
+	--
+	--     local defined = oro.shared 'mylib.defined'
+	assert(iscallable(cb.getshared), 'missing callback: getshared')
+	assert(iscallable(cb.setshared), 'missing callback: setshared')
+	local shared = {}
+	function oro.shared(name)
+		if type(name) ~= 'string' then
+			error('oro.shared() name must be a string; got ' .. type(name), 2)
+		end
+
+		local proxy = shared[name]
+		if proxy == nil then
+			proxy = setmetatable({}, {
+				__index = function (_, k) return cb:getshared(name, k) end,
+				__newindex = function (_, k, v) return cb:setshared(name, k, v) end,
+				__metatable = {}
+			})
+			shared[name] = proxy
+		end
+
+		return proxy
+	end
+
+	oro.Pool = require 'internal.globals.pool'
+	oro.cpucount = Oro.cpucount
+
 	oro.norm = require 'internal.globals.normlib'
 
 	-- Add an unknown variable guard (to avoid pitfalls).
@@ -11,15 +11,21 @@
 -- Creates a phony rule and (fake) build target
 -- to be used by exports, as one-off commands.
 --
+-- `oro.phony.console(...)` runs the command in
+-- Ninja's console pool, with direct access to the
+-- terminal (e.g. debuggers, or prompts).
+--
 
 local isinstance = require 'internal.util.isinstance'
 local Path = (require 'internal.path-factory').Path
 local List = require 'internal.util.list'
 local flat = require 'internal.util.flat'
 local freeze = require 'internal.util.freeze'
+local tablefunc = require 'internal.util.tablefunc'
+local console = (require 'internal.globals.pool').console
 
 local function make_phony_factory(makephony)
-	return function(...)
+	local function make_phony(pool, ...)
 		local deps = List()
 		local arguments = List()
 
@@ -34,8 +40,15 @@ local function make_phony_factory(makephony)
 			error('must specify at least one argument to oro.phony{}', 2)
 		end
 
-		return freeze(makephony(arguments, deps))
+		return freeze(makephony(arguments, deps, pool))
 	end
+
+	return tablefunc(
+		function (...) return make_phony(nil, ...) end,
+		{
+			console = function (...) return make_phony(console, ...) end
+		}
+	)
 end
 
 return make_phony_factory
@@ -0,0 +1,72 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Top-level `Pool{}` constructor. Rules in a pool
+-- run at most `depth` of their builds at a time
+-- (e.g. for memory-heavy link steps):
+--
+--     local links = oro.Pool { 'link', depth = 2 }
+--     local link = oro.Rule { pool = links, ... }
+--
+-- Builds can also be placed in a pool on their own
+-- (`pool = ...` in the build options), overriding
+-- their rule's.
+--
+-- `oro.Pool.console` is Ninja's built-in console pool:
+-- its (one at a time) builds get the terminal directly,
+-- for interactive commands.
+--
+
+local freeze = require 'internal.util.freeze'
+local tablefunc = require 'internal.util.tablefunc'
+local typename = require 'internal.util.typename'
+
+local Pool = {}
+
+local mt = {
+	__index = Pool,
+	__name = 'Pool'
+}
+
+local function make_pool(opts)
+	if type(opts) ~= 'table' then
+		error('Pool options must be a table; got ' .. typename(opts), 2)
+	end
+
+	local name = opts[1] or opts.name
+	if type(name) ~= 'string' or not name:match('^[%w_%-]+$') then
+		error('Pool{} name must be a non-empty identifier; got ' .. tostring(name), 2)
+	end
+
+	if name == 'console' then
+		error('Pool{} name \'console\' is reserved; use Pool.console', 2)
+	end
+
+	local depth = math.tointeger(opts.depth)
+	if depth == nil or depth < 1 then
+		error('Pool{} depth must be a positive integer; got ' .. tostring(opts.depth), 2)
+	end
+
+	return freeze(setmetatable({ name = name, depth = depth }, mt))
+end
+
+-- Built in; never declared
+local console = freeze(setmetatable(
+	{ name = 'console', depth = 1, builtin = true },
+	mt
+))
+
+return tablefunc(
+	make_pool,
+	{
+		Pool = Pool,
+		console = console
+	}
+)
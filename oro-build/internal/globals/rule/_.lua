@@ -11,6 +11,8 @@
 -- Top-level `Rule{}` constructor
 --
 
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
 local freeze = require 'internal.util.freeze'
 local flat = require 'internal.util.flat'
 local List = require 'internal.util.list'
@@ -20,18 +22,21 @@ local tablefunc = require 'internal.util.tablefunc'
 local Path = (require 'internal.path-factory').Path
 local isinstance = require 'internal.util.isinstance'
 local typename = require 'internal.util.typename'
+local Pool = (require 'internal.globals.pool').Pool
 
 -- https://ninja-build.org/manual.html
 local allowed_rule_keys = Set {
 	'command', 'depfile', 'deps',
 	'msvc_deps_prefix', 'description',
-	'dyndep', 'generator',
+	'dyndep', 'generator', 'pool',
 	'restat', 'rspfile', 'rspfile_content'
 }
 
 local Rule = {}
 local Build = {}
 
+local harness = P.relpath(Oro.absbindir, Oro.absharnesspath)
+
 local function flatten_to_strings(list, newlist)
 	if newlist == nil then newlist = {} end
 	local i = #newlist
@@ -46,22 +51,78 @@ local function flatten_to_strings(list, newlist)
 	return newlist
 end
 
+-- Quotes `s` for the shell, as Ninja does `$in`/`$out`
+local function shellquote(s)
+	if string.match(s, '^[%w_%+%-%.,/:@=]+$') then return s end
+	return "'" .. (s:gsub("'", "'\\''")) .. "'"
+end
+
+-- Wraps a rule's command with `--syscall write-if-changed`,
+-- which keeps outputs whose contents didn't change untouched.
+--
+-- The original command is written by Ninja to a response
+-- file (`$wicscript`) and run by a shell from there, so that
+-- Ninja's own escaping of `$in`/`$out` and any redirections
+-- work exactly as they would have. Each build sets the
+-- response file's path, and its shell-quoted form and
+-- implicit outputs for the command line (see make_build).
+local function write_if_changed(opts)
+	if opts.rspfile ~= nil or opts.rspfile_content ~= nil then
+		error('Rule{} option `writeifchanged` cannot be combined with `rspfile`', 3)
+	end
+
+	opts.rspfile = {'$wicscript'}
+	opts.rspfile_content = opts.command
+	opts.command = {
+		harness, '--syscall', 'write-if-changed', '$out', '$wicimplicit', '--',
+		'sh', '$wicscriptarg'
+	}
+	opts.restat = {'1'}
+end
+
+local function checkpool(pool, level)
+	if not isinstance(pool, Pool) then
+		error('Rule{} option `pool` must be an oro.Pool{}; got ' .. typename(pool), level + 1)
+	end
+
+	return pool
+end
+
 function Rule:clone(opts)
 	local new_opts = shallowclone(self.options)
+	new_opts.pool = self.pool
 
 	assert(
 		type(opts) == 'table',
 		'Rule options (first parameter, or braced invocation) must be table; got ' .. typename(opts)
 	)
 
+	if self.rawcommand ~= nil then
+		new_opts.command = self.rawcommand
+		new_opts.rspfile = nil
+		new_opts.rspfile_content = nil
+
+		if opts.writeifchanged == false then
+			new_opts.restat = nil
+		else
+			new_opts.writeifchanged = true
+		end
+	elseif opts.writeifchanged then
+		new_opts.writeifchanged = true
+	end
+
 	for k,v in pairs(opts) do
-		if not allowed_rule_keys[k] then
+		if k == 'writeifchanged' then
+			-- handled above
+		elseif not allowed_rule_keys[k] then
 			error('invalid Rule{} option: ' .. tostring(k), 2)
 		end
 
 		if v == false then
 			-- `false` unsets
 			new_opts[k] = nil
+		elseif k == 'pool' then
+			new_opts[k] = checkpool(v, 2)
 		else
 			new_opts[k] = flatten_to_strings(v)
 		end
@@ -81,12 +142,32 @@ local function make_rule_generator(onrule, onbuild)
 
 		local sane_opts = {}
 
+		local pool = nil
+
 		for k,v in pairs(opts) do
-			if not allowed_rule_keys[k] then
+			if k == 'writeifchanged' then
+				-- handled below
+			elseif not allowed_rule_keys[k] then
 				error('invalid Rule{} option: ' .. tostring(k), 2)
+			elseif k == 'pool' then
+				pool = checkpool(v, 2)
+				sane_opts.pool = pool.name
+			else
+				sane_opts[k] = flatten_to_strings(v)
 			end
+		end
 
-			sane_opts[k] = flatten_to_strings(v)
+		-- `writeifchanged = true` makes the rule leave outputs
+		-- with unchanged contents alone (for generators that
+		-- always rewrite their outputs) and restats them.
+		local rawcommand = nil
+		if opts.writeifchanged then
+			if sane_opts.command == nil then
+				error('Rule{} option `writeifchanged` requires a `command`', 2)
+			end
+
+			rawcommand = sane_opts.command
+			write_if_changed(sane_opts)
 		end
 
 		local function make_build(opts)
@@ -99,11 +180,16 @@ local function make_rule_generator(onrule, onbuild)
 			-- __index and __len metamethods.
 			local sane_opts = {out = {}}
 			local inputs = List()
+			local build_pool = nil
 
 			for k,v in pairs(opts) do
 				local kt = type(k)
 
-				if kt == 'string' then
+				if k == 'pool' then
+					-- overrides the rule's pool
+					build_pool = checkpool(v, 2)
+					sane_opts.pool = {build_pool.name}
+				elseif kt == 'string' then
 					sane_opts[k] = flatten_to_strings(v)
 				elseif kt ~= 'number' then
 					error('build keys must be strings (or sequential numbers); got ' .. kt, 2)
@@ -126,10 +212,27 @@ local function make_rule_generator(onrule, onbuild)
 
 			inputs = flatten_to_strings(inputs, sane_opts)
 
+			-- (see write_if_changed())
+			if rawcommand ~= nil then
+				local first = sane_opts.out[1] or (sane_opts.out_implicit or {})[1]
+				if first == nil then
+					error('builds of `writeifchanged` rules must have an output', 2)
+				end
+
+				local script = tostring(first) .. '.oro-cmd'
+				sane_opts.wicscript = {script}
+				sane_opts.wicscriptarg = {shellquote(script)}
+				sane_opts.wicimplicit = {}
+				for i, v in ipairs(sane_opts.out_implicit or {}) do
+					sane_opts.wicimplicit[i] = shellquote(tostring(v))
+				end
+			end
+
 			local build = setmetatable(
 				{
 					options = sane_opts,
-					rule = rule
+					rule = rule,
+					pool = build_pool
 				},
 				{
 					__index = function(_, k)
@@ -138,7 +241,9 @@ local function make_rule_generator(onrule, onbuild)
 						end
 						return Build[k]
 					end,
-					__len = function() return #sane_opts.out end
+					__len = function() return #sane_opts.out end,
+					-- (see internal.module-cache)
+					__build = true
 					-- NOTE: Builds are NOT nuclear! This would break flat() calls.
 					-- NOTE: Please do NOT add a __name here!
 					-- __name = 'Build'
@@ -153,6 +258,8 @@ local function make_rule_generator(onrule, onbuild)
 		rule = setmetatable(
 			{
 				options = sane_opts,
+				rawcommand = rawcommand,
+				pool = pool,
 				constructor = make_rule
 			},
 			{
@@ -181,7 +288,8 @@ local function make_rule_generator(onrule, onbuild)
 			pass = builtin 'internal.globals.rule.pass',
 			fail = builtin 'internal.globals.rule.fail',
 			echo = builtin 'internal.globals.rule.echo',
-			cp = builtin 'internal.globals.rule.cp'
+			cp = builtin 'internal.globals.rule.cp',
+			batch = builtin 'internal.globals.rule.batch'
 		}
 	)
 end
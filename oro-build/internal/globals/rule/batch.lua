@@ -0,0 +1,128 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Runs many syscall operations (`touch`, `cp`, etc.)
+-- from a single edge, and thus a single process:
+--
+--     oro.Rule.batch {
+--         { 'touch', B'stamp' },
+--         { 'cp', S'a.txt', B'a.txt' }
+--     }
+--
+-- `touch` arguments and the last `cp` argument are the
+-- edge's outputs; other `cp` arguments are its inputs.
+--
+
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
+local freeze = require 'internal.util.freeze'
+local flatten = require 'internal.util.flatten'
+local List = require 'internal.util.list'
+
+local rule = {
+	options = {
+		command = {
+			P.relpath(Oro.absbindir, Oro.absharnesspath),
+			'--syscall',
+			'batch',
+			'$rspfile'
+		},
+		rspfile = '$batchrsp',
+		rspfile_content = '$batchops',
+		description = 'BATCH $out',
+		-- copies keep their source's mtime, which may be older
+		-- than the edge's other inputs (and unchanged ones are
+		-- left untouched)
+		restat = '1'
+	}
+}
+
+local function quote(arg)
+	arg = tostring(arg)
+
+	if arg:find("'", 1, true) then
+		error('oro.Rule.batch{} arguments cannot contain single quotes: '..arg, 3)
+	end
+
+	if arg == '' or arg == ';' or arg:find('[%s]') then
+		return "'"..arg.."'"
+	end
+
+	return arg
+end
+
+local function make_rule(onrule, onbuild)
+	return function(opts)
+		if type(opts) ~= 'table' then
+			error('options must be a table; got '..tostring(opts), 2)
+		end
+
+		onrule(rule)
+
+		local outputs = List()
+		local inputs = List()
+		local ops = List()
+
+		for i, op in ipairs(opts) do
+			if type(op) ~= 'table' then
+				error('oro.Rule.batch{} operation #'..i..' must be a table; got '..tostring(op), 2)
+			end
+
+			local args = flatten{op}
+			local name = args[1]
+
+			if name == 'touch' then
+				for j = 2, #args do outputs[nil] = args[j] end
+			elseif name == 'cp' then
+				if #args ~= 3 then
+					error('oro.Rule.batch{} `cp` operation #'..i..' takes exactly one source and destination', 2)
+				end
+
+				inputs[nil] = args[2]
+				outputs[nil] = args[3]
+			elseif name ~= 'pass' and name ~= 'echo' then
+				error('unsupported oro.Rule.batch{} operation #'..i..': '..tostring(name), 2)
+			end
+
+			if #ops > 0 then ops[nil] = ';' end
+			for _, arg in ipairs(args) do
+				ops[nil] = quote(arg)
+			end
+		end
+
+		for _, v in ipairs(flatten{opts.out}) do
+			outputs[nil] = v
+		end
+
+		if #outputs == 0 then
+			error('oro.Rule.batch{} must produce at least one output', 2)
+		end
+
+		opts = {
+			in_implicit = opts.in_implicit,
+			in_order = opts.in_order,
+			out = outputs,
+			out_implicit = opts.out_implicit,
+			batchrsp = tostring(outputs[1])..'.rsp',
+			batchops = ops,
+
+			inputs
+		}
+
+		onbuild {
+			rule = rule,
+			options = opts
+		}
+
+		return freeze{opts.out, opts.out_implicit}
+	end
+end
+
+return make_rule
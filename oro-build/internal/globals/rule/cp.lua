@@ -26,7 +26,9 @@ local rule = {
 			'$in',
 			'$outleaf'
 		},
-		description = 'COPY $in -> $outleaf'
+		description = 'COPY $in -> $outleaf',
+		-- identical outputs are left untouched
+		restat = '1'
 	}
 }
 
@@ -0,0 +1,419 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Cached module evaluations, kept across
+-- re-configurations in `<bin_dir>/.oro/modules`
+-- (next to each module's own Ninja file).
+--
+-- When a build script (the root or a local import)
+-- is evaluated, everything it does and everything it
+-- reads from outside of itself is recorded: inherited
+-- config/env reads and writes, rules and builds, the
+-- results of its imports, the standard libraries it
+-- uses, `oro.shared` tables and its exports.
+--
+-- Regenerations (i.e. Ninja re-running the configuration
+-- after a script changed) replay a module's record
+-- instead of evaluating its script when neither its
+-- script nor any of those inputs changed (see
+-- Context:canreplay()). Explicit re-configurations
+-- always evaluate every script, so that they pick up
+-- changes the records can't see (e.g. a replaced
+-- compiler or other `oro.execute` results).
+--
+-- Modules whose inputs or exports can't be serialized
+-- (e.g. exported functions) are never cached.
+--
+
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
+local List = require 'internal.util.list'
+local freeze = require 'internal.util.freeze'
+local isinstance = require 'internal.util.isinstance'
+local pathlib = require 'internal.path-factory'
+local lfs = require 'lfs'
+
+local debug = require 'debug'
+
+local Path = pathlib.Path
+
+-- Bump when the record format changes
+local FORMAT = 1
+
+local moduledir = '.oro/modules'
+
+local enabled = os.getenv('_ORO_BUILD_REGEN') ~= nil
+
+local listmethods = debug.getmetatable(List()).__index
+
+local replays = 0
+local evaluations = 0
+
+--
+-- Values are serialized to Lua expressions over `P`
+-- (Paths), `L` (Lists) and `F` (frozen objects). Builds
+-- are serialized as their outputs, which is all that
+-- scripts can use them for. Returns nil for anything
+-- else (functions, rules, cyclic tables, ...).
+--
+
+local write
+
+local function writetable(v, out, visiting)
+	if visiting[v] then return false end
+	visiting[v] = true
+
+	local n = rawlen(v)
+	for i = 1, n do
+		if not write(rawget(v, i), out, visiting) then return false end
+		out[#out + 1] = ','
+	end
+
+	local others = {}
+	for k, _ in next, v do
+		if math.type(k) ~= 'integer' or k < 1 or k > n then
+			local kout = {}
+			if not write(k, kout, visiting) then return false end
+			others[#others + 1] = { table.concat(kout), k }
+		end
+	end
+	table.sort(others, function (a, b) return a[1] < b[1] end)
+
+	for _, kv in ipairs(others) do
+		out[#out + 1] = '['
+		out[#out + 1] = kv[1]
+		out[#out + 1] = ']='
+		if not write(rawget(v, kv[2]), out, visiting) then return false end
+		out[#out + 1] = ','
+	end
+
+	visiting[v] = nil
+	return true
+end
+
+write = function (v, out, visiting)
+	local t = type(v)
+
+	if t == 'nil' or t == 'boolean' then
+		out[#out + 1] = tostring(v)
+	elseif t == 'number' or t == 'string' then
+		out[#out + 1] = string.format('%q', v)
+	elseif t == 'table' then
+		local mt = getmetatable(v)
+		if type(mt) == 'table' and mt.__frozen then
+			out[#out + 1] = 'F('
+			if not write(freeze.unfreeze(v), out, visiting) then return false end
+			out[#out + 1] = ')'
+		elseif isinstance(v, Path) then
+			out[#out + 1] = string.format('P(%q,%q)', v._path, v._base)
+		else
+			mt = debug.getmetatable(v)
+			if mt == nil then
+				out[#out + 1] = '{'
+				if not writetable(v, out, visiting) then return false end
+				out[#out + 1] = '}'
+			elseif mt.__index == listmethods then
+				out[#out + 1] = 'L{'
+				if not writetable(v, out, visiting) then return false end
+				out[#out + 1] = '}'
+			elseif mt.__build then
+				out[#out + 1] = 'L{'
+				if not writetable(rawget(v, 'options').out, out, visiting) then return false end
+				out[#out + 1] = '}'
+			else
+				return false
+			end
+		end
+	else
+		return false
+	end
+
+	return true
+end
+
+local function serialize(v)
+	local out = {}
+	if not write(v, out, {}) then return nil end
+	return table.concat(out)
+end
+
+local loadenv = {
+	P = pathlib.intern,
+	L = List,
+	F = freeze
+}
+
+local function deserialize(s)
+	return assert(load('return ' .. s, '=module-cache', 't', loadenv))()
+end
+
+-- Contents hashes, by absolute path (files are
+-- assumed not to change during a configuration)
+local filehashes = {}
+
+local function filehash(path)
+	local hash = filehashes[path]
+
+	if hash == nil then
+		hash = false
+		local stream = io.open(path, 'rb')
+		if stream ~= nil then
+			hash = Oro.hashstring(stream:read('a'))
+			stream:close()
+		end
+		filehashes[path] = hash
+	end
+
+	return hash or nil
+end
+
+-- Records are only valid for the harness
+-- (and internal Lua code) that wrote them
+local version = nil
+
+local function harnessversion()
+	if version == nil then
+		local parts = { tostring(FORMAT) }
+
+		local function add(path)
+			parts[#parts + 1] = path
+			parts[#parts + 1] = filehash(path) or ''
+		end
+
+		add(P.join(Oro.absrootdir, 'oro-build.lua'))
+		add(P.join(Oro.absrootdir, 'oro-build.c'))
+
+		local function walk(dir)
+			if lfs.attributes(dir, 'mode') ~= 'directory' then return end
+
+			local names = {}
+			for name in lfs.dir(dir) do
+				if name ~= '.' and name ~= '..' then
+					names[#names + 1] = name
+				end
+			end
+			table.sort(names)
+
+			for _, name in ipairs(names) do
+				local path = P.join(dir, name)
+				if lfs.attributes(path, 'mode') == 'directory' then
+					walk(path)
+				else
+					add(path)
+				end
+			end
+		end
+
+		walk(P.join(Oro.absrootdir, 'internal'))
+
+		version = Oro.hashstring(table.concat(parts, '\0'))
+	end
+
+	return version
+end
+
+local function mkdirs(dir)
+	if dir == '' or lfs.attributes(dir, 'mode') == 'directory' then return end
+	mkdirs(P.dirname(dir))
+	lfs.mkdir(dir)
+end
+
+-- Module files are named after their script
+-- (relative to the source directory)
+local function filename(pathname, ext)
+	local name = P.basename(pathname)
+	if pathname ~= Oro.absbuildscript then
+		-- (standard library modules live outside of the source tree)
+		name = P.relpath(Oro.abssrcdir, pathname):gsub('%.%.', '__')
+	end
+
+	return P.join(moduledir, name .. ext)
+end
+
+-- The module's Ninja file, relative to the build directory
+local function ninjafile(pathname)
+	return filename(pathname, '.ninja')
+end
+
+local records = {}
+
+local function loadrecord(pathname)
+	local record = records[pathname]
+
+	if record == nil then
+		record = false
+
+		local chunk = loadfile(P.join(Oro.absbindir, filename(pathname, '.lua')), 't', loadenv)
+		if chunk ~= nil then
+			local ok, res = pcall(chunk)
+			if ok and type(res) == 'table' and res.version == harnessversion() then
+				record = res
+			end
+		end
+
+		records[pathname] = record
+	end
+
+	return record or nil
+end
+
+-- Starts recording the evaluation of the script at `pathname`
+local function start(pathname)
+	evaluations = evaluations + 1
+
+	return {
+		script = filehash(pathname),
+		inherited = { config = {}, env = {} },
+		log = {}
+	}
+end
+
+-- Renders a module's record (see Context and Module:log()
+-- for the events), or returns nil if it can't be cached.
+local function encode(module)
+	local record = module.record
+	local out = { 'return {\n' }
+
+	local function emit(...)
+		for _, v in ipairs{...} do
+			out[#out + 1] = v
+		end
+	end
+
+	local function expr(v)
+		local s = serialize(v)
+		if s == nil then error(false) end
+		return s
+	end
+
+	local function quote(s)
+		if s == nil then error(false) end
+		return string.format('%q', s)
+	end
+
+	local function poolspec(pool)
+		if pool == nil then return nil end
+		return { name = pool.name, depth = pool.depth, builtin = pool.builtin }
+	end
+
+	local rules = {}
+	local ruleindices = {}
+
+	local function ruleindex(rule)
+		local s = expr({ rule.options, poolspec(rule.pool) })
+		local index = ruleindices[s]
+		if index == nil then
+			rules[#rules + 1] = s
+			index = #rules
+			ruleindices[s] = index
+		end
+		return tostring(index)
+	end
+
+	local ok = pcall(function ()
+		local sig = module:signature()
+
+		emit('version=', quote(harnessversion()), ',\n')
+		emit('script=', quote(record.script), ',\n')
+		emit('sig=', quote(sig), ',\n')
+		emit('exports=', expr(module.exports), ',\n')
+		emit('default=', expr(module.default_export), ',\n')
+		emit('log={\n')
+
+		for _, event in ipairs(record.log) do
+			local kind = event[1]
+			emit('{', quote(kind), ',')
+
+			if kind == 'config' or kind == 'env' then
+				emit(expr(event[2]), ',', quote(event[3]))
+			elseif kind == 'setconfig' or kind == 'setenv' then
+				emit(expr(event[2]), ',', quote(expr(event[3])))
+			elseif kind == 'rule' then
+				emit(ruleindex(event[2]))
+			elseif kind == 'build' then
+				emit(ruleindex(event[2]), ',', expr(event[3]), ',', expr(poolspec(event[4])))
+			elseif kind == 'childexport' then
+				emit(quote(event[2]), ',', expr(event[3]), ',', expr(event[4]))
+			elseif kind == 'import' then
+				emit(quote(event[2]), ',', quote(event[3]))
+			elseif kind == 'std' then
+				emit(quote(event[2]), ',', expr(event[3]))
+			elseif kind == 'sharedread' then
+				emit(quote(event[2]), ',', quote(event[3]), ',', quote(event[4]))
+			elseif kind == 'sharedwrite' then
+				emit(quote(event[2]), ',', quote(event[3]), ',', quote(expr(event[4])))
+			else
+				error('unknown module cache event: ' .. tostring(kind))
+			end
+
+			emit('},\n')
+		end
+
+		emit('},\n')
+		emit('rules={\n')
+		for _, s in ipairs(rules) do
+			emit(s, ',\n')
+		end
+		emit('}\n}\n')
+	end)
+
+	if not ok then return nil end
+	return table.concat(out)
+end
+
+-- Writes (or, if it can't be cached, removes) the
+-- record of a module that was just evaluated
+local function save(module)
+	local path = P.join(Oro.absbindir, filename(module.pathname, '.lua'))
+	local chunk = encode(module)
+
+	if chunk == nil then
+		os.remove(path)
+		return
+	end
+
+	mkdirs(P.dirname(path))
+
+	local tmppath = path .. '.tmp'
+	local stream = assert(io.open(tmppath, 'wb'))
+	stream:write(chunk)
+	stream:close()
+
+	assert(os.rename(tmppath, path))
+end
+
+local function replayed()
+	replays = replays + 1
+end
+
+local function report(to_stream)
+	if not enabled then return end
+
+	to_stream:write(
+		'Module cache: '
+		.. tostring(replays) .. ' replayed, '
+		.. tostring(evaluations) .. ' evaluated\n'
+	)
+end
+
+return {
+	enabled = enabled,
+	serialize = serialize,
+	deserialize = deserialize,
+	filehash = filehash,
+	ninjafile = ninjafile,
+	mkdirs = mkdirs,
+	load = loadrecord,
+	start = start,
+	save = save,
+	replayed = replayed,
+	replays = function () return replays end,
+	report = report
+}
@@ -12,9 +12,9 @@
 -- and code generator
 --
 
-local flat = require 'internal.util.flat'
+local Oro = require 'internal.oro'
+local Profile = require 'internal.profile'
 local Set = require 'internal.util.set'
-local isnuclear = require 'internal.util.isnuclear'
 local tablefunc = require 'internal.util.tablefunc'
 
 local Ninja = {}
@@ -22,136 +22,45 @@ local Ninja = {}
 local ninja_rule_keys = Set {
 	'command', 'depfile', 'deps', 'msvc_deps_prefix',
 	'description', 'dyndep', 'generator', 'in',
-	'in_newline', 'out', 'restat', 'rspfile',
+	'in_newline', 'out', 'pool', 'restat', 'rspfile',
 	'rspfile_content'
 }
 
-function Ninja:write(to_stream)
-	to_stream:write('#\n# THIS IS A GENERATED BUILD CONFIGURATION')
-	to_stream:write('\n# DO NOT MANUALLY EDIT!\n#')
-	to_stream:write('\n\nninja_required_version = 1.1')
-
-	-- NOTE: this emits the initial ' ' if a value is found.
-	local function escape(v, colon)
-		-- re-assign here to ignore second returned value
-		v = v:gsub(colon and '[ \n:]' or '[ \n]', '$%0')
-		return v
-	end
-
-	local function emit(v)
-		if type(v) == 'table' and not isnuclear(v) then
-			for v in flat(v) do
-				to_stream:write(' ')
-				to_stream:write(escape(tostring(v)))
-			end
-		elseif v ~= nil then
-			to_stream:write(' ')
-			to_stream:write(tostring(v))
-		end
-	end
-
-	for name, opts in pairs(self.rules) do
-		-- sanity checks
-		assert(opts.command ~= nil)
-
-		-- emit
-		to_stream:write('\n\nrule ')
-		to_stream:write(tostring(name))
-
-		for opt_name, opt_val in pairs(opts) do
-			to_stream:write('\n  ')
-			to_stream:write(tostring(opt_name))
-			to_stream:write(' =')
-			emit(opt_val)
-		end
-	end
-
-	for _, build_def in ipairs(self.builds) do
-		local rule_name, opts = build_def.rule, build_def.opts
-
-		-- sanity checks
-		assert(rule_name ~= nil)
-		assert(opts ~= nil)
-		assert(opts['in'] == nil) -- checked in the `add_build` method
-		assert(opts['In'] == nil)
-
-		-- emit
-		to_stream:write('\n\nbuild')
-		local ignore_keys = {}
-
-		if opts.out ~= nil then
-			ignore_keys.out = true
-			for v in flat(opts.out) do
-				if v then
-					to_stream:write(' ')
-					to_stream:write(escape(tostring(v), true))
-				end
-			end
-		end
-
-		if opts.out_implicit ~= nil then
-			ignore_keys.out_implicit = true
-			to_stream:write(' |')
-			for v in flat(opts.out_implicit) do
-				if v then
-					to_stream:write(' ')
-					to_stream:write(escape(tostring(v), true))
-				end
-			end
-		end
-
-		to_stream:write(': ')
-		to_stream:write(tostring(rule_name))
-
-		for v in flat(opts) do
-			if v then
-				to_stream:write(' ')
-				to_stream:write(escape(tostring(v), true))
-			end
-		end
-
-		if opts.in_implicit ~= nil then
-			ignore_keys.in_implicit = true
-			to_stream:write(' |')
-			for v in flat(opts.in_implicit) do
-				if v then
-					to_stream:write(' ')
-					to_stream:write(escape(tostring(v), true))
-				end
-			end
-		end
-
-		if opts.in_order ~= nil then
-			ignore_keys.in_order = true
-			to_stream:write(' ||')
-			for v in flat(opts.in_order) do
-				if v then
-					to_stream:write(' ')
-					to_stream:write(escape(tostring(v), true))
-				end
-			end
-		end
-
-		for k, v in pairs(opts) do
-			if type(k) == 'string' and not ignore_keys[k] then
-				to_stream:write('\n  ')
-				to_stream:write(k)
-				to_stream:write(' =')
-				emit(v)
-			end
-		end
-	end
+-- Renders the build file to `path` (natively; see
+-- `write_ninja` in the harness). The file is left
+-- untouched if its contents would not change.
+-- Returns whether it was written.
+function Ninja:write(path)
+	Profile.begin('write ' .. path, 'ninja')
+	local written = Oro.writeninja(
+		path,
+		self.rules,
+		self.builds,
+		self.defaults,
+		self.pools,
+		self.subninjas
+	)
+	Profile.finish { builds = #self.builds, written = written }
+	return written
+end
 
-	if #self.defaults > 0 then
-		to_stream:write('\n')
+-- Includes another Ninja file (`path`, relative to the
+-- build directory) in its own scope, after the rules.
+function Ninja:add_subninja(path)
+	self.subninjas[#self.subninjas + 1] = path
+	return self
+end
 
-		for _, def_output in ipairs(self.defaults) do
-			to_stream:write('\ndefault ')
-			to_stream:write(escape(tostring(def_output)))
-		end
-	end
+function Ninja:add_pool(name, depth)
+	local existing = self.pools[name]
+	assert(
+		existing == nil or existing == depth,
+		'conflicting depths for pool ' .. name .. ': '
+			.. tostring(existing) .. ' and ' .. tostring(depth)
+	)
 
-	to_stream:write('\n\n# END OF BUILD SCRIPT\n')
+	self.pools[name] = depth
+	return self
 end
 
 function Ninja:add_rule(name, opts)
@@ -175,8 +84,13 @@ function Ninja:add_phony(name, inputs)
 	return self
 end
 
+function Ninja:has_rule(name)
+	return self.rules[name] ~= nil
+		or (self.scope ~= nil and self.scope:has_rule(name))
+end
+
 function Ninja:add_build(rule_name, opts)
-	assert(self.rules[rule_name] ~= nil, 'unknown rule: ' .. rule_name)
+	assert(self:has_rule(rule_name), 'unknown rule: ' .. rule_name)
 	assert(
 		opts['in'] == nil and opts['In'] == nil,
 		'do not specify `in` or `In` directly; pass inputs as sequence items instead'
@@ -196,11 +110,16 @@ function Ninja:has_defaults()
 	return #self.defaults > 0
 end
 
-local function Ninjafile()
+-- `scope` is the including file (see :add_subninja()),
+-- whose rules are visible to this one.
+local function Ninjafile(scope)
 	local ninja = {
+		scope = scope,
 		rules = {},
 		builds = {},
-		defaults = {}
+		defaults = {},
+		pools = {},
+		subninjas = {}
 	}
 
 	return setmetatable(ninja, {__index = Ninja})
@@ -39,7 +39,23 @@ local Oro = {
 	buildscript = ORO.build_script,
 	searchpath = ORO.search_path,
 	execute = ORO.execute,
+	executemany = ORO.execute_many,
 	split = ORO.split,
+	pathjoin = ORO.path_join,
+	pathnormalize = ORO.path_normalize,
+	pathrelpath = ORO.path_relpath,
+	pathsplitext = ORO.path_splitext,
+	pathbasename = ORO.path_basename,
+	pathdirname = ORO.path_dirname,
+	flat = ORO.flat,
+	isnuclear = ORO.is_nuclear,
+	writeninja = ORO.write_ninja,
+	loadcached = ORO.load_cached,
+	hashstring = ORO.hash_string,
+	cpucount = ORO.cpu_count,
+	profiling = ORO.profiling,
+	monotime = ORO.monotime,
+	profilestats = ORO.profile_stats,
 	env = ORO.env,
 	arg = ORO.arg
 }
@@ -53,6 +69,11 @@ require('path.fs')
 require('path')
 package.path = origpath
 
+-- `internal.path` is backed by the native functions
+-- above; let it `require` this (partially initialized)
+-- module without recursing.
+package.loaded['internal.oro'] = Oro
+
 local P = require 'internal.path'
 
 Oro.absrootdir = P.resolve(Oro.rootdir)
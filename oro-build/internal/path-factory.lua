@@ -23,6 +23,23 @@ local typename = require 'internal.util.typename'
 local Path = {}
 local Path__mt = nil
 
+-- Paths are immutable and interned by (base, path), so
+-- repeated references to the same file share a single
+-- object (and its cached string form; see Path__tostring).
+local interned = setmetatable({}, { __mode = 'v' })
+
+local function make_path(path, base)
+	local key = base .. '\0' .. path
+	local p = interned[key]
+
+	if p == nil then
+		p = setmetatable({ _path = path, _base = base }, Path__mt)
+		interned[key] = p
+	end
+
+	return p
+end
+
 local function pathstring(x, prop)
 	if isinstance(x, Path) then
 		return x[prop]
@@ -39,10 +56,7 @@ function Path:path(s)
 	if s == nil then
 		return self._path
 	else
-		return setmetatable(
-			{ _path = pathstring(s, '_path'), _base = self._base },
-			Path__mt
-		)
+		return make_path(pathstring(s, '_path'), self._base)
 	end
 end
 
@@ -50,10 +64,7 @@ function Path:base(s)
 	if s == nil then
 		return self._base
 	else
-		return setmetatable(
-			{ _path = self._path, _base = pathstring(s, '_base') },
-			Path__mt
-		)
+		return make_path(self._path, pathstring(s, '_base'))
 	end
 end
 
@@ -61,12 +72,9 @@ function Path:basename(s)
 	if s == nil then
 		return P.basename(self._path)
 	else
-		return setmetatable(
-			{
-				_path = P.join(P.dirname(self._path), pathstring(s, '_path')),
-				_base = self._base
-			},
-			Path__mt
+		return make_path(
+			P.join(P.dirname(self._path), pathstring(s, '_path')),
+			self._base
 		)
 	end
 end
@@ -104,15 +112,20 @@ function Path:join(pth)
 end
 
 local function Path__tostring(self)
+	local str = self._string
+	if str ~= nil then return str end
+
 	local path, base = self._path, self._base
 
-	if #base == 0 then return path end
+	if #base == 0 then
+		str = path
+	else
+		-- NOTE: normalization removes any trailing separator.
+		str = P.normalize(P.join(base, path))
+	end
 
-	return P.normalize(
-		(P.has_dir_end(path) and P.ensure_dir_end or P.remove_dir_end)(
-			P.join(base, path)
-		)
-	)
+	rawset(self, '_string', str)
+	return str
 end
 
 local function make_path_factory(source_root, build_root)
@@ -134,13 +147,7 @@ local function make_path_factory(source_root, build_root)
 			)
 		end
 
-		return setmetatable(
-			{
-				_path = path,
-				_base = base,
-			},
-			Path__mt
-		)
+		return make_path(path, base)
 	end
 
 	return function(path)
@@ -157,12 +164,17 @@ end
 Path__mt = {
 	__index = Path,
 	__name = 'Path', -- required to make object "nuclear"
-	__tostring = Path__tostring
+	__tostring = Path__tostring,
+	__newindex = function()
+		error('Path objects are immutable', 2)
+	end
 }
 
 return tablefunc(
 	make_path_factory,
 	{
-		Path = Path
+		Path = Path,
+		-- (for deserialization; see internal.module-cache)
+		intern = make_path
 	}
 )
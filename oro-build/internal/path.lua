@@ -13,40 +13,28 @@
 
 require 'path.fs'
 
-local unpack = require 'internal.util.unpack'
-local List = require 'internal.util.list'
+local Oro = require 'internal.oro'
 
 local P = setmetatable({}, {
 	__index = (require 'path').new('/')
 })
 
-local real_join = P.join
-function P.join(...)
-	-- Annoyingly, the builtin `join` function
-	-- treats empty strings as valid paths.
-	-- This causes P.join(maybezerolength, 'foo')
-	-- as '/foo', which wreaks havoc on the path
-	-- library - namely, when using P.dirname(),
-	-- which returns an empty first leaf for
-	-- non-nested relative paths.
-	local leafs = List()
-
-	for _, v in ipairs{...} do
-		if v ~= nil then
-			local vs = tostring(v)
-			if #vs > 0 then
-				leafs[nil] = vs
-			end
-		end
-	end
-
-	return real_join(unpack(leafs))
-end
-
-local real_normalize = P.normalize
-function P.normalize(pth)
-	return P.remove_dir_end(real_normalize(pth))
-end
+-- The hot path operations are implemented natively
+-- (see the `path_*` functions in oro-build.c); they
+-- back every Path stringification. The rest still
+-- come from lua-path.
+--
+-- Unlike lua-path's `join`, nil and empty segments
+-- are skipped (otherwise P.join(maybezerolength, 'foo')
+-- would produce '/foo', which wreaks havoc on the path
+-- library - namely, when using P.dirname(), which returns
+-- an empty first leaf for non-nested relative paths).
+P.join = Oro.pathjoin
+P.normalize = Oro.pathnormalize
+P.relpath = Oro.pathrelpath
+P.splitext = Oro.pathsplitext
+P.basename = Oro.pathbasename
+P.dirname = Oro.pathdirname
 
 function P.asabs(pth)
 	if P.isabs(pth) then
@@ -65,51 +53,6 @@ function P.asrel(pth)
 	end
 end
 
-function P.relpath(from, to)
-	assert(P.isabs(from))
-	assert(P.isabs(to))
-
-	from = P.normalize(from)
-	to = P.normalize(to)
-
-	if from == to then
-		return '.'
-	end
-
-	while true do
-		local f_leaf, f_path = P.splitroot(from)
-		local t_leaf, t_path = P.splitroot(to)
-
-		if f_leaf == t_leaf then
-			from = P.asabs(f_path)
-			to = P.asabs(t_path)
-		else
-			break
-		end
-	end
-
-	from = P.normalize(P.asrel(from))
-	to = P.normalize(P.asrel(to))
-
-	local joins = {}
-
-	while true do
-		if from == '' then
-			break
-		else
-			joins[#joins + 1] = '..'
-		end
-
-		from = P.dirname(from)
-	end
-
-	joins[#joins + 1] = to
-
-	return P.normalize(
-		P.join(unpack(joins))
-	)
-end
-
 function P.resolve(pth, to)
 	if P.isabs(pth) then
 		return pth
@@ -0,0 +1,252 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Configure-time profiler, enabled by setting
+-- `ORO_PROFILE` (to anything but `0`).
+--
+-- Spans (see `begin()`/`finish()`) record their wall
+-- time, the bytes allocated by Lua and the time spent
+-- in `oro.execute`/`oro.executemany` (both counted by
+-- the harness). Spans that belong to a module are also
+-- totalled per module, along with the number of rules
+-- and builds it defined.
+--
+-- At the end of a configuration a summary table is
+-- written to stderr, and a Chrome trace (for
+-- chrome://tracing or https://ui.perfetto.dev) to
+-- `<bin_dir>/.oro/profile.json`.
+--
+
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
+
+local enabled = Oro.profiling
+local libdir = P.join(Oro.absrootdir, 'lib')
+
+local epoch = Oro.monotime()
+local stack = {}
+local events = {}
+local modules = {}
+local moduleorder = {}
+
+local function stats(module)
+	local s = modules[module]
+	if s == nil then
+		s = {
+			label = '?',
+			total = 0,
+			self = 0,
+			alloc = 0,
+			execns = 0,
+			executes = 0,
+			rules = 0,
+			builds = 0
+		}
+		modules[module] = s
+		moduleorder[#moduleorder + 1] = s
+	end
+	return s
+end
+
+-- The name under which a script is reported
+local function label(pathname)
+	if pathname:sub(1, #libdir + 1) == libdir .. '/' then
+		return 'std:' .. pathname:sub(#libdir + 2)
+	end
+	return P.relpath(Oro.abssrcdir, pathname)
+end
+
+-- Opens a span; `module` (if any) is the Module it
+-- is attributed to.
+local function begin(name, category, module)
+	if not enabled then return end
+
+	local alloc, executes, execns = Oro.profilestats()
+
+	if module ~= nil and stats(module).label == '?' then
+		stats(module).label = name
+	end
+
+	stack[#stack + 1] = {
+		name = name,
+		category = category,
+		module = module,
+		start = Oro.monotime(),
+		alloc = alloc,
+		executes = executes,
+		execns = execns,
+		-- totals of nested spans
+		childns = 0,
+		childalloc = 0,
+		childexecns = 0,
+		childexecutes = 0
+	}
+end
+
+-- Closes the innermost span; `args` (if any) are
+-- added to its trace event.
+local function finish(args)
+	if not enabled then return end
+
+	local now = Oro.monotime()
+	local alloc, executes, execns = Oro.profilestats()
+	local span = table.remove(stack)
+	assert(span ~= nil, 'Profile.finish() without a matching begin()')
+
+	local dur = now - span.start
+	alloc = alloc - span.alloc
+	executes = executes - span.executes
+	execns = execns - span.execns
+
+	local parent = stack[#stack]
+	if parent ~= nil then
+		parent.childns = parent.childns + dur
+		parent.childalloc = parent.childalloc + alloc
+		parent.childexecns = parent.childexecns + execns
+		parent.childexecutes = parent.childexecutes + executes
+	end
+
+	local eventargs = {
+		alloc_bytes = alloc,
+		executes = executes,
+		execute_us = execns / 1000
+	}
+
+	if span.module ~= nil then
+		local s = stats(span.module)
+		s.total = s.total + dur
+		s.self = s.self + dur - span.childns
+		s.alloc = s.alloc + alloc - span.childalloc
+		s.execns = s.execns + execns - span.childexecns
+		s.executes = s.executes + executes - span.childexecutes
+		eventargs.rules = s.rules
+		eventargs.builds = s.builds
+	end
+
+	for k, v in pairs(args or {}) do
+		eventargs[k] = v
+	end
+
+	events[#events + 1] = {
+		name = span.name,
+		category = span.category,
+		ts = (span.start - epoch) / 1000,
+		dur = dur / 1000,
+		args = eventargs
+	}
+end
+
+-- Counts a rule or build (`kind`) defined by `module`
+local function count(module, kind)
+	if not enabled or module == nil then return end
+	local s = stats(module)
+	s[kind] = s[kind] + 1
+end
+
+local function jsonstring(str)
+	return '"' .. tostring(str):gsub('[%c"\\]', function (c)
+		return string.format('\\u%04x', c:byte())
+	end) .. '"'
+end
+
+local function jsonvalue(v)
+	if type(v) == 'number' then
+		if math.type(v) == 'integer' then return tostring(v) end
+		return string.format('%.3f', v)
+	elseif type(v) == 'boolean' then
+		return tostring(v)
+	end
+	return jsonstring(v)
+end
+
+-- Writes the Chrome trace
+local function save()
+	if not enabled then return end
+
+	local out = {}
+	for i, event in ipairs(events) do
+		local args = {}
+		for k, v in pairs(event.args) do
+			args[#args + 1] = jsonstring(k) .. ':' .. jsonvalue(v)
+		end
+		table.sort(args)
+
+		out[i] = string.format(
+			'{"name":%s,"cat":%s,"ph":"X","ts":%.3f,"dur":%.3f,"pid":1,"tid":1,"args":{%s}}',
+			jsonstring(event.name),
+			jsonstring(event.category),
+			event.ts,
+			event.dur,
+			table.concat(args, ',')
+		)
+	end
+
+	local path = P.join(Oro.absbindir, '.oro/profile.json')
+	local stream = assert(io.open(path, 'wb'))
+	stream:write('{"traceEvents":[\n', table.concat(out, ',\n'), '\n]}\n')
+	stream:close()
+end
+
+-- Writes the summary table, slowest modules first
+local function report(to_stream)
+	if not enabled then return end
+
+	local rows = {}
+	for i, s in ipairs(moduleorder) do rows[i] = s end
+	table.sort(rows, function (a, b)
+		if a.total ~= b.total then return a.total > b.total end
+		return a.label < b.label
+	end)
+
+	local function ms(ns) return string.format('%.1f', ns / 1e6) end
+	local function kib(bytes) return string.format('%.0f', bytes / 1024) end
+
+	local format = '%10s %10s %10s %10s %6s %6s %6s  %s\n'
+	to_stream:write('Configure profile:\n')
+	to_stream:write(string.format(
+		format,
+		'total(ms)', 'self(ms)', 'alloc(KiB)', 'exec(ms)', 'execs', 'rules', 'builds', 'module'
+	))
+
+	for _, s in ipairs(rows) do
+		to_stream:write(string.format(
+			format,
+			ms(s.total), ms(s.self), kib(s.alloc), ms(s.execns),
+			tostring(s.executes), tostring(s.rules), tostring(s.builds), s.label
+		))
+	end
+
+	local writes, writens = 0, 0
+	for _, event in ipairs(events) do
+		if event.category == 'ninja' then
+			writes = writes + 1
+			writens = writens + event.dur * 1000
+		end
+	end
+
+	local alloc, executes, execns = Oro.profilestats()
+	to_stream:write(
+		'Ninja: ' .. tostring(writes) .. ' file(s) in ' .. ms(writens) .. 'ms; '
+		.. 'oro.execute: ' .. tostring(executes) .. ' call(s) in ' .. ms(execns) .. 'ms; '
+		.. 'Lua: ' .. kib(alloc) .. ' KiB allocated; '
+		.. 'total: ' .. ms(Oro.monotime() - epoch) .. 'ms\n'
+		.. 'Trace: ' .. P.join(Oro.absbindir, '.oro/profile.json') .. '\n'
+	)
+end
+
+return {
+	enabled = enabled,
+	label = label,
+	begin = begin,
+	finish = finish,
+	count = count,
+	save = save,
+	report = report
+}
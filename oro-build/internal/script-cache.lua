@@ -0,0 +1,55 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Compiled chunk cache for build scripts and
+-- standard library modules, kept in
+-- `<bin_dir>/.oro/cache`.
+--
+-- Entries are keyed by the script's absolute path
+-- and a hash of its source (see `load_cached` in
+-- the harness).
+--
+
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
+local lfs = require 'lfs'
+
+local cachedir = P.join(Oro.absbindir, '.oro/cache')
+lfs.mkdir(cachedir)
+
+local hits = 0
+local misses = 0
+
+local function load(pathname, env)
+	local chunk, hit = Oro.loadcached(pathname, cachedir, env)
+
+	if chunk ~= nil then
+		if hit then
+			hits = hits + 1
+		else
+			misses = misses + 1
+		end
+	end
+
+	return chunk, hit
+end
+
+local function report(to_stream)
+	to_stream:write(
+		'Script cache: '
+		.. tostring(hits) .. ' hit(s), '
+		.. tostring(misses) .. ' miss(es)\n'
+	)
+end
+
+return {
+	load = load,
+	report = report
+}
@@ -13,49 +13,12 @@
 -- (tables with __name MT entries)
 --
 
-local isnuclear = require 'internal.util.isnuclear'
-local iscallable = require 'internal.util.iscallable'
-
-local function flat(t)
-	local stack = {{{t}, 1}}
-
-	local function iter(i)
-		local v = i[1][i[2]]
-		i[2] = i[2] + 1
-		return v
-	end
-
-	local nextv = nil
-	nextv = function()
-		local v = stack[#stack]
-		if v == nil then return end
-		v = iter(v)
-
-		while v == nil do
-			stack[#stack] = nil
-			v = stack[#stack]
-			if v == nil then return nil end
-			v = iter(v)
-		end
-
-		while type(v) == 'table' do
-			-- Special handling for "nuclear" objects
-			-- (those with a __name MT entry)
-			if isnuclear(v) then break end
-
-			if #v == 0 then return nextv() end
-
-			itr = {v, 1}
-			stack[#stack + 1] = itr
-			v = iter(itr)
-		end
-
-		if v == nil then return nextv() end
-
-		return v
-	end
+--
+-- Implemented natively in the harness (`flat` in
+-- oro-build.c) since it's used for every build
+-- input/output; see bench/flat.lua.
+--
 
-	return nextv
-end
+local Oro = require 'internal.oro'
 
-return flat
+return Oro.flat
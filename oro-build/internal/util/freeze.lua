@@ -41,6 +41,48 @@ local debug = require 'debug'
 local tablefunc = require 'internal.util.tablefunc'
 local iscallable = require 'internal.util.iscallable'
 
+-- Each underlying object gets at most one proxy (per
+-- kind of `newindex` handling), so that reading through
+-- frozen objects doesn't allocate a new proxy on every
+-- access. Weak keys let the proxies be collected along
+-- with their objects.
+local weak_keys = { __mode = 'k' }
+local frozen_readonly = setmetatable({}, weak_keys)
+local frozen_forwarding = setmetatable({}, weak_keys)
+local frozen_functions = setmetatable({}, weak_keys)
+
+-- The `__metatable` facades only depend on the underlying
+-- object's name and callability, so they're shared.
+local facades = { [true] = {}, [false] = {} }
+local noname = {}
+
+local function get_facade(name, callable)
+	local bucket = facades[callable]
+	local key = name == nil and noname or name
+	local facade = bucket[key]
+
+	if facade == nil then
+		facade = setmetatable({}, {
+			__index = function(_, k)
+				if k == '__frozen' then return true end
+				if k == '__name' then return name end
+				-- used by iscallable() to check callability of frozen objects
+				-- without needing to unfreeze them (since we also depend on
+				-- iscallable)
+				if k == '__callable' then return callable end
+				error('attempt to index a frozen object\'s metatable', 2)
+			end,
+			__newindex = function()
+				error('attempt to assign to a frozen object\'s metatable', 2)
+			end
+		})
+
+		bucket[key] = facade
+	end
+
+	return facade
+end
+
 local function unfreeze(obj)
 	local mt = getmetatable(obj)
 	if type(mt) == 'table' and mt.__frozen then
@@ -62,16 +104,33 @@ local function freeze(obj, newindex)
 
 	local objt = type(obj)
 	if objt == 'function' then
-		return function (this, ...)
-			this = unfreeze(this)
-			return obj(this, ...)
+		local fn = frozen_functions[obj]
+		if fn == nil then
+			fn = function (this, ...)
+				this = unfreeze(this)
+				return obj(this, ...)
+			end
+			frozen_functions[obj] = fn
 		end
+		return fn
 	end
 
 	if objt ~= 'table' and objt ~= 'userdata' then
 		return obj
 	end
 
+	local cache = nil
+	if newindex == nil then
+		cache = frozen_readonly
+	elseif newindex == true then
+		cache = frozen_forwarding
+	end
+
+	if cache ~= nil then
+		local existing = cache[obj]
+		if existing ~= nil then return existing end
+	end
+
 	local omt = getmetatable(obj)
 	if type(omt) ~= 'table' then omt = nil end
 
@@ -138,22 +197,15 @@ local function freeze(obj, newindex)
 	local name = nil
 	if omt then name = omt.__name end
 
-	mt.__metatable = setmetatable({}, {
-		__index = function(_, k)
-			if k == '__frozen' then return true end
-			if k == '__name' then return name end
-			-- used by iscallable() to check callability of frozen objects
-			-- without needing to unfreeze them (since we also depend on
-			-- iscallable)
-			if k == '__callable' then return callable end
-			error('attempt to index a frozen object\'s metatable', 2)
-		end,
-		__newindex = function()
-			error('attempt to assign to a frozen object\'s metatable', 2)
-		end
-	})
+	mt.__metatable = get_facade(name, callable)
+
+	setmetatable(proxy, mt)
+
+	if cache ~= nil then
+		cache[obj] = proxy
+	end
 
-	return setmetatable(proxy, mt)
+	return proxy
 end
 
 local real_rawset = rawset
@@ -22,9 +22,8 @@
 -- For example, Path objects are 'nuclear'.
 --
 
-local function isnuclear(v)
-	local meta = getmetatable(v)
-	return meta ~= nil and meta.__name ~= nil
-end
+-- Implemented natively in the harness (`is_nuclear`
+-- in oro-build.c).
+local Oro = require 'internal.oro'
 
-return isnuclear
+return Oro.isnuclear
@@ -12,6 +12,327 @@
 --
 
 local configure = require 'cc._configure'
+local lto = require 'cc._lto'
+local pgo = require 'cc._pgo'
+
+-- (shared so that cached module evaluations replay them)
+local pch_cache = oro.shared 'cc.pch'
+
+local CXX_EXTENSIONS = {
+	['.cc'] = true, ['.cpp'] = true, ['.cxx'] = true,
+	['.c++'] = true, ['.C'] = true
+}
+
+local function fnv1a(str)
+	local hash = 0xcbf29ce484222325
+	for i = 1, #str do
+		hash = (hash ~ string.byte(str, i)) * 0x100000001b3
+	end
+	return string.format('%016x', hash)
+end
+
+-- Whether sources are C++20 modules (`modules` or `C.CXX_MODULES`)
+local function modules_enabled(opts)
+	local modules = opts.modules
+	if modules == nil then modules = C.CXX_MODULES end
+	if modules == nil or modules == false then return false end
+	modules = tostring(modules)
+	return modules ~= '' and modules ~= '0'
+end
+
+-- Builds (once per compiler, header and set of flags)
+-- the precompiled `header`, returning it along with
+-- the flags that make objects use it.
+local function make_pch(compiler, header, cflags, opts)
+	if not oro.ispath(header) then
+		error('`pch` must be a Path; got ' .. type.name(header), 3)
+	end
+
+	local variant = compiler.variant
+	local pchflags = oro.List{cflags}
+
+	if opts.noforce then
+		-- Headers are C by default; follow the sources
+		for v in table.flat(opts) do
+			if oro.ispath(v) and CXX_EXTENSIONS[v:ext()] then
+				pchflags[nil] = variant.flag_force_cxx_header
+				break
+			end
+		end
+	elseif modules_enabled(opts) then
+		pchflags[nil] = variant.flag_force_cxx_header
+	else
+		pchflags[nil] = variant.flag_force_c_header
+	end
+
+	local parts = { compiler.compiler_command, tostring(header) }
+	for v in table.flat(pchflags) do
+		parts[#parts + 1] = tostring(v)
+	end
+
+	local key = table.concat(parts, '\0')
+	local pch = pch_cache[key]
+
+	if pch == nil then
+		local pchheader = B('.pch/' .. fnv1a(key)):join(header:basename())
+		local pchfile = pchheader:append(variant.pch_extension)
+
+		compiler.rule {
+			header,
+			out = {pchfile},
+			cflags = pchflags
+		}
+
+		pch = {
+			file = pchfile,
+			flags = variant.flag_use_pch(pchheader, pchfile)
+		}
+
+		pch_cache[key] = pch
+	end
+
+	return pch
+end
+
+local DEFAULT_UNITY_SIZE = 8
+
+local unity_rule = oro.Rule {
+	command = { oro.syscall 'unity', '$out', '$sources' },
+	description = 'UNITY $out',
+	restat = '1'
+}
+
+-- The number of sources per unity translation unit,
+-- from `unity` (`true` for the default) or `C.UNITY`.
+-- 0 or 1 disables unity builds.
+local function unity_size(opts)
+	local unity = opts.unity
+	if unity == nil then unity = C.UNITY end
+	if unity == nil or unity == false then return 0 end
+	if unity == true then return DEFAULT_UNITY_SIZE end
+
+	local n = tonumber(tostring(unity))
+	if n == nil or n < 0 or n ~= math.floor(n) then
+		error('`unity` must be a boolean or non-negative integer; got ' .. tostring(unity), 3)
+	end
+
+	return n
+end
+
+-- The object for `source`, under `objdir` if given
+local function objectpath(objdir, source)
+	if objdir ~= nil then
+		return objdir:join(source):append('.o')
+	end
+
+	return B(source):append('.o')
+end
+
+-- Compiles `sources` in generated unity ("jumbo") translation
+-- units of up to `size` sources each (under `objdir`, if given),
+-- appending the objects to `out`. Sources with different extensions aren't mixed. Returns
+-- the sources that must still be compiled on their own (those in
+-- `nounity`, and any that would be alone in a unit).
+local function make_unity(compiler, sources, size, nounity, cflags, implicit, objdir, out)
+	local excluded = {}
+	for v in table.flat{nounity} do
+		excluded[tostring(v)] = true
+	end
+
+	local unitydir = objdir ~= nil and objdir:join('.unity') or B'.unity'
+
+	local singles = oro.List()
+	local byext = {}
+	local exts = {}
+
+	for _, v in ipairs(sources) do
+		if excluded[tostring(v)] then
+			singles[nil] = v
+		else
+			local ext = v:ext()
+			if byext[ext] == nil then
+				byext[ext] = {}
+				exts[#exts + 1] = ext
+			end
+			local group = byext[ext]
+			group[#group + 1] = v
+		end
+	end
+
+	for _, ext in ipairs(exts) do
+		local group = byext[ext]
+
+		for first = 1, #group, size do
+			local last = math.min(first + size - 1, #group)
+
+			if first == last then
+				singles[nil] = group[first]
+			else
+				local unit = {}
+				local parts = {}
+				for i = first, last do
+					unit[#unit + 1] = group[i]
+					parts[#parts + 1] = tostring(group[i])
+				end
+
+				local unityfile = unitydir:join(fnv1a(table.concat(parts, '\0')) .. ext)
+				local outfile = unityfile:append('.o')
+
+				unity_rule {
+					out = {unityfile},
+					sources = unit
+				}
+
+				out[nil] = outfile
+				compiler.rule {
+					unityfile,
+					out = {outfile},
+					-- ordering for generated sources (changes
+					-- are picked up through the depfile)
+					in_implicit = {unit, implicit},
+					cflags = cflags
+				}
+			end
+		end
+	end
+
+	return singles
+end
+
+local scan_rules = {}
+
+local collate_rule = oro.Rule {
+	command = {
+		oro.syscall 'cxx-modules-collate',
+		'$out', '$bmidir', '$bmiext', '$modmapformat', '--', '$objects'
+	},
+	description = 'COLLATE $out',
+	restat = '1'
+}
+
+-- The scans (and BMI directories) of each C++ module
+-- target's sources and of the targets it imports, by
+-- the objects it returned (see `import`).
+local module_targets = oro.shared 'cc.modules'
+
+-- Compiles C++20 module `sources`, appending the objects to `out`.
+-- Each source is scanned for the modules it provides and imports
+-- (P1689), and the scans are collated into a dyndep file for the
+-- target (under `objdir`, if given) that orders the compilations
+-- by their module dependencies as the build runs. `imports` are
+-- the objects of other module targets whose modules the sources
+-- may import; any other imports are left to the compiler.
+local function make_modules(compiler, sources, cflags, implicit, objdir, out, imports)
+	local variant = compiler.variant
+
+	local units = oro.List()
+	local seen = {}
+	local importobjects = oro.List()
+
+	for v in table.flat{imports} do
+		local target = module_targets[v]
+		if target == nil then
+			error('`import` must list objects of C++ module targets; got ' .. tostring(v), 3)
+		end
+
+		importobjects[nil] = v
+		for _, unit in ipairs(target) do
+			if not seen[unit.scan] then
+				seen[unit.scan] = true
+				units[nil] = unit
+			end
+		end
+	end
+
+	-- (the command is looked up on every call; see _configure)
+	local scan_command = variant.scan_command()
+	local scan_key = table.concat(scan_command, '\0')
+	local scan = scan_rules[scan_key]
+	if scan == nil then
+		scan = oro.Rule {
+			command = scan_command,
+			depfile = '$out.d',
+			description = 'SCAN $out'
+		}
+		scan_rules[scan_key] = scan
+	end
+
+	local parts = {}
+	for i, v in ipairs(sources) do
+		parts[i] = tostring(v)
+	end
+
+	local moduledir = objdir ~= nil and objdir:join('.cxxmodules') or B'.cxxmodules'
+	local dir = moduledir:join(fnv1a(table.concat(parts, '\0')))
+	local dyndep = dir:join('modules.dd')
+
+	local objects = {}
+	local modmaps = {}
+	local scans = oro.List()
+	local collated = oro.List()
+
+	for i, v in ipairs(sources) do
+		local object = objectpath(objdir, v)
+		local scanfile = object:append('.ddi')
+
+		objects[i] = object
+		modmaps[i] = object:append('.modmap')
+		scans[nil] = scanfile
+		collated[nil] = {object, scanfile}
+
+		scan {
+			v,
+			out = {scanfile},
+			in_implicit = implicit,
+			cc = compiler.compiler_command_args,
+			obj = object,
+			cflags = cflags
+		}
+	end
+
+	-- The imported targets are built first, so that Ninja
+	-- knows which of their compilations produce the BMIs
+	-- by the time it loads this target's dyndep file.
+	local importscans = oro.List()
+	local importargs = nil
+	if #units > 0 then
+		importargs = oro.List{'--'}
+		for _, unit in ipairs(units) do
+			importscans[nil] = unit.scan
+			importargs[nil] = {unit.bmidir, unit.scan}
+		end
+	end
+
+	collate_rule {
+		scans,
+		out = {dyndep},
+		out_implicit = modmaps,
+		in_implicit = importscans,
+		in_order = importobjects,
+		bmidir = dir,
+		bmiext = variant.bmi_extension,
+		modmapformat = variant.modmap_format,
+		objects = collated,
+		imports = importargs
+	}
+
+	for _, scanfile in ipairs(scans) do
+		units[nil] = {bmidir = dir, scan = scanfile}
+	end
+
+	for i, v in ipairs(sources) do
+		out[nil] = objects[i]
+		compiler.rule {
+			v,
+			out = {objects[i]},
+			in_implicit = {modmaps[i], implicit},
+			in_order = {dyndep},
+			dyndep = dyndep,
+			cflags = {cflags, variant.flag_modmap(modmaps[i])}
+		}
+		module_targets[objects[i]] = units
+	end
+end
 
 local function cc_builder(_, opts)
 	local compiler = configure()
@@ -20,10 +341,6 @@ local function cc_builder(_, opts)
 
 	cflags[nil] = compiler.variant.flag_compile_object
 
-	if not opts.noforce then
-		cflags[nil] = compiler.variant.flag_force_c
-	end
-
 	if opts.preprocess_only == 'nodebug' then
 		cflags[nil] = compiler.variant.flag_preprocess_only_nodebug
 	elseif opts.preprocess_only then
@@ -48,6 +365,21 @@ local function cc_builder(_, opts)
 		cflags[nil] = compiler.variant.flag_debug
 	end
 
+	local lto_mode = lto.mode(opts)
+	if lto_mode ~= nil then
+		cflags[nil] = compiler.variant.flag_lto(lto_mode)
+	end
+
+	local pgo_opt = pgo.check(opts.pgo, 2)
+	if pgo_opt ~= nil then
+		cflags[nil] = compiler.variant.flag_pgo(
+			pgo_opt.phase,
+			pgo_opt.data,
+			pgo_opt.objdir,
+			pgo_opt.profile
+		)
+	end
+
 	if opts.werror then cflags[nil] = compiler.variant.flag_warn_error end
 
 	if opts.warn ~= nil then
@@ -105,6 +437,49 @@ local function cc_builder(_, opts)
 		end
 	end
 
+	local modules = modules_enabled(opts)
+	if modules then
+		cflags[nil] = compiler.variant.flag_modules
+	elseif opts.import ~= nil then
+		error('`import` requires C++ modules (`modules`)', 2)
+	end
+
+	local pch = nil
+	if opts.pch ~= nil then
+		pch = make_pch(compiler, opts.pch, cflags, opts)
+	end
+
+	-- The language (and PCH) flags differ between
+	-- the PCH and the objects that use it.
+	cflags = oro.List{cflags}
+
+	if not opts.noforce then
+		-- (module sources are C++, whatever their extension)
+		if modules then
+			cflags[nil] = compiler.variant.flag_force_cxx
+		else
+			cflags[nil] = compiler.variant.flag_force_c
+		end
+	end
+
+	if pch ~= nil then
+		cflags[nil] = pch.flags
+	end
+
+	local implicit = oro.List()
+	if pch ~= nil then
+		implicit[nil] = pch.file
+	end
+
+	-- Optimized objects follow the profile
+	local objdir = nil
+	if pgo_opt ~= nil then
+		objdir = pgo_opt.objdir
+		if pgo_opt.phase == 'use' then
+			implicit[nil] = pgo_opt.profile
+		end
+	end
+
 	if opts.out then
 		if type(opts.out) == 'table' then
 			if (
@@ -125,23 +500,23 @@ local function cc_builder(_, opts)
 			)
 		end
 
+		if modules then
+			error('C++ modules need a list of sources (not `out`)', 2)
+		end
+
 		return compiler.rule {
 			opts,
 			out = {opts.out},
+			in_implicit = implicit,
 			cflags = cflags
 		}
 	else
 		local out = oro.List()
+		local sources = oro.List()
 
 		for v in table.flat(opts) do
 			if oro.ispath(v) then
-				local outfile = B(v):append('.o')
-				out[nil] = outfile
-				compiler.rule {
-					v,
-					out = {outfile},
-					cflags = cflags
-				}
+				sources[nil] = v
 			else
 				error(
 					'compilation inputs must be (lists of) Paths; got '
@@ -153,6 +528,27 @@ local function cc_builder(_, opts)
 			end
 		end
 
+		if modules then
+			make_modules(compiler, sources, cflags, implicit, objdir, out, opts.import)
+			return out
+		end
+
+		local unity = unity_size(opts)
+		if unity > 1 then
+			sources = make_unity(compiler, sources, unity, opts.nounity, cflags, implicit, objdir, out)
+		end
+
+		for _, v in ipairs(sources) do
+			local outfile = objectpath(objdir, v)
+			out[nil] = outfile
+			compiler.rule {
+				v,
+				out = {outfile},
+				in_implicit = implicit,
+				cflags = cflags
+			}
+		end
+
 		return out
 	end
 end
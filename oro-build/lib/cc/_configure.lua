@@ -16,14 +16,37 @@
 local DEFAULT_COMPILER = {} -- marker table, used as a key
 local rule_cache = {}
 
-local makeDepfile = oro.Rule {
-	command = {
-		oro.syscall 'init-depfile', '$out'
-	},
-	description = 'INIT DEPFILE $out'
-}
-
-local function configure_compiler(compiler_command, skip_prelude)
+local DEFAULT_CACHE_SIZE = '5G'
+
+-- Resolves the object cache directory from `C.CC_CACHE`:
+-- unset, empty or '0' disables it, '1' uses a per-user
+-- directory, and anything else is an absolute path.
+local function cc_cache_dir()
+	local setting = C.CC_CACHE
+	if setting == nil then return nil end
+
+	setting = tostring(setting)
+	if setting == '' or setting == '0' then return nil end
+
+	if setting == '1' then
+		local base = E.XDG_CACHE_HOME
+		if base == nil or #base == 0 then
+			if E.HOME == nil then
+				error('C.CC_CACHE=1 requires either XDG_CACHE_HOME or HOME to be set', 2)
+			end
+			base = E.HOME .. '/.cache'
+		end
+		return base .. '/oro-build/cc'
+	end
+
+	if not string.startswith(setting, '/') then
+		error('C.CC_CACHE must be 0, 1 or an absolute directory path; got: ' .. setting, 2)
+	end
+
+	return setting
+end
+
+local function configure_compiler(compiler_command, cache_dir, cache_size, skip_prelude)
 	local compiler_command_args = string.split(tostring(compiler_command), ' \t\n')
 
 	local resolved_command = oro.searchpath(compiler_command_args[1], E.PATH or '')
@@ -41,11 +64,15 @@ local function configure_compiler(compiler_command, skip_prelude)
 		print('configuring C compiler: ' .. compiler_command)
 	end
 
-	local status, stdout, stderr = oro.execute{
-		raise=false,
-		compiler_command_args[1],
-		'--version'
-	}
+	-- Probes with the whole command, so that launchers
+	-- (e.g. `CC='ccache gcc'`) report the real compiler.
+	local probe = {raise=false, cache=true}
+	for _, arg in ipairs(compiler_command_args) do
+		probe[#probe + 1] = arg
+	end
+	probe[#probe + 1] = '--version'
+
+	local status, stdout, stderr = oro.execute(probe)
 
 	if status ~= 0 then
 		if stderr == nil or #stderr == 0 then
@@ -76,50 +103,68 @@ local function configure_compiler(compiler_command, skip_prelude)
 	local variant = require ('cc._variant.'..use_variant)
 	assert(variant ~= nil)
 
-	local rule = oro.Rule {
+	-- The depfile is initialized before the compiler
+	-- runs (and overwrites it). This is to appease Ninja
+	-- in cases where the compiler decides not to
+	-- initialize a depfile because none of its inputs
+	-- are "sources", without a separate edge per object.
+	-- The object cache (if enabled) does the same.
+	local wrapper = {oro.syscall 'with-depfile', '$out.d', '--'}
+
+	if cache_dir ~= nil then
+		print('\tobject cache: ' .. cache_dir .. ' (max ' .. cache_size .. ')')
+		wrapper = {
+			oro.syscall 'cc-cache',
+			cache_dir,
+			cache_size,
+			'$out',
+			'$out.d',
+			'--'
+		}
+	end
+
+	-- The compiler itself is a build variable (`$cc`),
+	-- so that compilers of a kind share a Ninja rule.
+	local compile_rule = oro.Rule {
 		command = {
-			compiler_command_args,
+			wrapper,
+			'$cc',
 			variant.flag_output('$out'),
 			variant.flag_dep_output('$out.d'),
 			'$cflags',
 			'$in'
 		},
 		depfile = '$out.d',
-		description = 'CC(' .. oro.Rule.escapeall(compiler_command) .. ') $out'
+		description = 'CC($cc) $out'
 	}
 
-	local function depfileRule_(_, opts)
-		for outfile in table.flat{opts.out} do
-			-- Guarantee that the depfile exists.
-			-- This is to appease Ninja in cases
-			-- where the compiler decides not to
-			-- initialize a depfile because none
-			-- of its inputs are "sources".
-			makeDepfile { out = outfile:append('.d') }
-			opts.in_order = { outfile:append('.d'), opts.in_order }
-			break
+	local function rule(opts)
+		local build = { cc = compiler_command_args }
+		for k, v in pairs(opts) do
+			build[k] = v
 		end
-
-		return rule(opts)
+		return compile_rule(build)
 	end
 
-	local depfileRule = setmetatable({}, {
-		__call = depfileRule_,
-		__index = rule,
-		__newindex = rule
-	})
-
 	print('\tOK')
 
 	return {
-		rule = depfileRule,
+		rule = rule,
+		-- Without the depfile and cache wrappers
+		link_command = {
+			'$cc',
+			variant.flag_output('$out'),
+			'$cflags',
+			'$in'
+		},
 		variant_name = use_variant,
 		variant = variant,
-		compiler_command = compiler_command
+		compiler_command = compiler_command,
+		compiler_command_args = compiler_command_args
 	}
 end
 
-local function detect_default_compiler()
+local function detect_default_compiler(cache_dir, cache_size)
 	print('detecting system C compiler...')
 
 	local to_test = {'cc', 'gcc', 'clang', 'tcc'}
@@ -149,22 +194,35 @@ local function detect_default_compiler()
 	end
 
 	print('\tfound:', resolved)
-	return configure_compiler(resolved, true)
+	return configure_compiler(resolved, cache_dir, cache_size, true)
 end
 
 local function configure()
 	local compiler_command = C.CC or E.CC or DEFAULT_COMPILER
 
-	local rule = rule_cache[compiler_command]
+	-- Everything the configuration depends on is read on
+	-- every call, not just the first, so that each module's
+	-- cached evaluation records it as an input.
+	local cache_dir = cc_cache_dir()
+	local cache_size = tostring(C.CC_CACHE_SIZE or DEFAULT_CACHE_SIZE)
+	local key = table.concat({tostring(E.PATH), tostring(cache_dir), cache_size}, '\0')
+
+	local rules = rule_cache[compiler_command]
+	if rules == nil then
+		rules = {}
+		rule_cache[compiler_command] = rules
+	end
+
+	local rule = rules[key]
 
 	if rule == nil then
 		if compiler_command == DEFAULT_COMPILER then
-			rule = detect_default_compiler()
+			rule = detect_default_compiler(cache_dir, cache_size)
 		else
-			rule = configure_compiler(compiler_command)
+			rule = configure_compiler(compiler_command, cache_dir, cache_size)
 		end
 
-		rule_cache[compiler_command] = rule
+		rules[key] = rule
 	end
 
 	assert(rule ~= nil)
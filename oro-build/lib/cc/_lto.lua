@@ -0,0 +1,89 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Link-time optimization settings, shared by the
+-- `cc` and `link` libraries.
+--
+-- Each LTO link runs `C.LTO_JOBS` (default: all CPUs)
+-- backend jobs, and links are capped through a Ninja
+-- pool so that, together, they don't oversubscribe
+-- the machine.
+--
+-- `C.LTO_LINKER` (e.g. 'lld', 'gold' or 'mold') picks
+-- the linker LTO links use (`-fuse-ld=`); otherwise,
+-- ThinLTO links use lld and full LTO links the
+-- compiler's default linker.
+--
+
+local MODES = { thin = 'thin', full = 'full' }
+
+-- ThinLTO's cache, relative to the build root
+local CACHE_DIR = '.oro/thinlto-cache'
+
+-- Returns 'thin', 'full' or nil from the `lto`
+-- option (or `C.LTO`); `true` means 'full'.
+local function lto_mode(opts)
+	local lto = opts.lto
+	if lto == nil then lto = C.LTO end
+	if lto == nil or lto == false then return nil end
+	if lto == true then return 'full' end
+
+	lto = tostring(lto)
+	if lto == '' or lto == '0' then return nil end
+	if lto == '1' then return 'full' end
+
+	local mode = MODES[lto]
+	if mode == nil then
+		error('`lto` must be either \'thin\' or \'full\'; got ' .. lto, 3)
+	end
+
+	return mode
+end
+
+-- (by depth; see lto_pool())
+local pools = {}
+
+-- `C.LTO_JOBS` is read on every call, so that each
+-- module's cached evaluation records it as an input.
+local function lto_jobs()
+	local jobs = math.tointeger(tonumber(tostring(C.LTO_JOBS or oro.cpucount)))
+	if jobs == nil or jobs < 1 then
+		error('C.LTO_JOBS must be a positive integer; got ' .. tostring(C.LTO_JOBS), 3)
+	end
+
+	return jobs
+end
+
+-- (also read on every call)
+local function lto_linker()
+	local linker = C.LTO_LINKER
+	if linker == nil or tostring(linker) == '' then return nil end
+	return tostring(linker)
+end
+
+local function lto_pool()
+	local depth = math.max(1, oro.cpucount // lto_jobs())
+	local pool = pools[depth]
+
+	if pool == nil then
+		pool = oro.Pool { 'oro_lto', depth = depth }
+		pools[depth] = pool
+	end
+
+	return pool
+end
+
+return {
+	mode = lto_mode,
+	jobs = lto_jobs,
+	linker = lto_linker,
+	pool = lto_pool,
+	cachedir = CACHE_DIR
+}
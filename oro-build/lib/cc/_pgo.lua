@@ -0,0 +1,71 @@
+--  __   __   __
+-- /  \ |__) /  \
+-- \__/ |  \ \__/
+--
+-- ORO BUILD GENERATOR
+-- Copyright (c) 2021-2022, Josh Junon
+-- License TBD
+--
+
+--
+-- Profile-guided optimization settings, shared by
+-- the `cc` and `link` libraries.
+--
+-- A PGO set (see `link.pgo{}`) lives under `.pgo/<name>`
+-- in the build root:
+--
+--   gen/     instrumented objects and executable
+--   use/     optimized objects
+--   data/    raw profiles written by training runs
+--   profile  the merged profile
+--
+-- `set.generate` and `set.use` are passed to cc{} and
+-- link.exe{} as their `pgo` option.
+--
+
+local PHASES = { generate = true, use = true }
+
+local function make_pgo(name)
+	if type(name) ~= 'string' or string.match(name, '^[%w_%-%.]+$') == nil then
+		error('PGO set names must be non-empty strings of [A-Za-z0-9_.-]; got ' .. tostring(name), 3)
+	end
+
+	local root = B('.pgo/' .. name)
+	local data = root:join('data')
+	local profile = root:join('profile')
+
+	return {
+		name = name,
+		root = root,
+		data = data,
+		profile = profile,
+		generate = {
+			phase = 'generate',
+			objdir = root:join('gen'),
+			data = data,
+			profile = profile
+		},
+		use = {
+			phase = 'use',
+			objdir = root:join('use'),
+			data = data,
+			profile = profile
+		}
+	}
+end
+
+-- Validates a `pgo` option, returning it (or nil)
+local function check(pgo, level)
+	if pgo == nil or pgo == false then return nil end
+
+	if type(pgo) ~= 'table' or not PHASES[pgo.phase] or pgo.objdir == nil then
+		error('`pgo` must be a PGO set\'s `generate` or `use` member; got ' .. type.name(pgo), level + 1)
+	end
+
+	return pgo
+end
+
+return {
+	new = make_pgo,
+	check = check
+}
@@ -15,9 +15,75 @@
 local gcc_variant = require 'cc._variant.gcc'
 
 local clang_variant = {
-	flag_warn_everything = {'-Weverything'}
+	flag_warn_everything = {'-Weverything'},
+	pch_extension = '.pch',
+	flag_modules = {},
+	bmi_extension = '.pcm',
+	modmap_format = 'clang'
 }
 
+function clang_variant.flag_use_pch(_, pch)
+	return {'-include-pch', pch}
+end
+
+function clang_variant.flag_lto(mode)
+	return '-flto=' .. mode
+end
+
+-- ThinLTO's options (and cache) are lld's; full LTO
+-- works with any linker that has the LLVM plugin
+-- (the default, unless `linker` is given).
+function clang_variant.ldflag_lto(mode, jobs, cachedir, linker)
+	if mode == 'thin' then
+		return {
+			'-flto=thin',
+			'-fuse-ld=' .. (linker or 'lld'),
+			'-flto-jobs=' .. tostring(jobs),
+			'-Wl,--thinlto-cache-dir=' .. cachedir
+		}
+	end
+
+	return {'-flto=full', linker and ('-fuse-ld=' .. linker)}
+end
+
+function clang_variant.flag_pgo(phase, data, _, profile)
+	if phase == 'generate' then
+		return '-fprofile-generate=$$PWD/' .. tostring(data)
+	end
+
+	return '-fprofile-use=' .. tostring(profile)
+end
+
+function clang_variant.pgo_merge(data, out)
+	local profdata = C.LLVM_PROFDATA or oro.searchpath('llvm-profdata', E.PATH or '')
+	if profdata == nil then
+		error('clang PGO requires llvm-profdata; set C.LLVM_PROFDATA or add it to PATH', 4)
+	end
+
+	return {
+		tostring(profdata), 'merge', '-output=' .. out,
+		tostring(data) .. '/*.profraw'
+	}
+end
+
+-- The module map is a response file of flags
+function clang_variant.flag_modmap(modmap)
+	return '@' .. tostring(modmap)
+end
+
+function clang_variant.scan_command()
+	local scandeps = C.CLANG_SCAN_DEPS or oro.searchpath('clang-scan-deps', E.PATH or '')
+	if scandeps == nil then
+		error('C++ modules with clang require clang-scan-deps; set C.CLANG_SCAN_DEPS or add it to PATH', 4)
+	end
+
+	return {
+		tostring(scandeps), '-format=p1689', '--',
+		'$cc', '$cflags', '$in', '-o', '$obj',
+		'-MT', '$out', '-MD', '-MF', '$out.d', '>', '$out'
+	}
+end
+
 for k, v in pairs(gcc_variant) do
 	if clang_variant[k] == nil then
 		clang_variant[k] = v
@@ -14,6 +14,10 @@
 local gcc_variant = {
 	flag_compile_object = '-c',
 	flag_force_c = '-xc',
+	flag_force_cxx = '-xc++',
+	flag_force_c_header = '-xc-header',
+	flag_force_cxx_header = '-xc++-header',
+	pch_extension = '.gch',
 	flag_warn_error = '-Werror',
 	flag_warn_all = '-Wall',
 	flag_warn_all_plus = {'-Wall', '-Wextra', '-Wshadow', '-Wstrict-prototypes'},
@@ -26,7 +30,12 @@ local gcc_variant = {
 	flag_preprocess_only = '-E',
 	flag_preprocess_only_nodebug = {'-E', '-P'},
 
-	ldflag_release = '-s'
+	ldflag_release = '-s',
+
+	-- C++20 modules (scanning requires GCC 14+)
+	flag_modules = '-fmodules-ts',
+	bmi_extension = '.gcm',
+	modmap_format = 'gcc'
 }
 
 function gcc_variant.flag_include_directory(dir)
@@ -53,6 +62,67 @@ function gcc_variant.flag_dep_output(out)
 	return {'-MD', '-MF', out}
 end
 
+-- GCC picks up `<header>.gch` in place of `<header>`
+-- (which needn't exist); `-fpch-preprocess` lets `-E`
+-- (e.g. the object cache) see through it, too.
+function gcc_variant.flag_use_pch(header, _)
+	return {'-include', header, '-Winvalid-pch', '-fpch-preprocess'}
+end
+
+-- GCC has no ThinLTO; its (default) partitioned LTO
+-- is the closest equivalent, and it has no cache.
+function gcc_variant.flag_lto(_)
+	return '-flto'
+end
+
+function gcc_variant.ldflag_lto(_, jobs, _, linker)
+	return {'-flto=' .. tostring(jobs), linker and ('-fuse-ld=' .. linker)}
+end
+
+-- Both PGO object trees name their objects alike, so
+-- profiles are keyed relative to the tree (GCC 12+).
+-- `$$PWD` is expanded by the shell Ninja runs commands with.
+function gcc_variant.flag_pgo(phase, data, objdir, _)
+	local prefix = '-fprofile-prefix-path=$$PWD/' .. tostring(objdir)
+	if phase == 'generate' then
+		return {'-fprofile-generate=$$PWD/' .. tostring(data), prefix}
+	end
+
+	return {'-fprofile-use=$$PWD/' .. tostring(data), prefix, '-Wmissing-profile'}
+end
+
+function gcc_variant.ldflag_pgo(phase)
+	if phase == 'generate' then
+		return '-fprofile-generate'
+	end
+
+	return {}
+end
+
+-- GCC reads the raw profiles itself; the "merged" profile
+-- is a checksum listing of them, so that optimized objects
+-- rebuild only when the training results change.
+function gcc_variant.pgo_merge(data, out)
+	return {
+		'find', tostring(data), '-name', '\\*.gcda', '-exec', 'cksum', '{}', '+',
+		'|', 'sort', '>', out, '&&', 'test', '-s', out
+	}
+end
+
+function gcc_variant.flag_modmap(modmap)
+	return '-fmodule-mapper=' .. tostring(modmap)
+end
+
+-- Writes the P1689 module dependencies of `$in` (compiled
+-- to `$obj`) to `$out`.
+function gcc_variant.scan_command()
+	return {
+		'$cc', '$cflags', '-E', '-x', 'c++', '$in',
+		'-fdeps-format=p1689r5', '-fdeps-file=$out', '-fdeps-target=$obj',
+		'-MT', '$out', '-MD', '-MF', '$out.d', '-o', '$out.i'
+	}
+end
+
 function gcc_variant.flag_warn(name)
 	return '-W' .. tostring(name)
 end
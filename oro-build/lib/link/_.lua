@@ -13,32 +13,59 @@
 --
 
 local configure_cc = require 'cc._configure'
+local lto = require 'cc._lto'
+local pgo = require 'cc._pgo'
 
-local DEFAULT_COMPILER = {}
+local link_pools = {}
 
+-- `C.LINK_POOL` caps how many (non-LTO) links run
+-- at once, for memory-heavy links.
+local function default_pool()
+	if C.LINK_POOL == nil then return nil end
+
+	local depth = math.tointeger(tonumber(tostring(C.LINK_POOL)))
+	if depth == nil or depth < 1 then
+		error('C.LINK_POOL must be a positive integer; got ' .. tostring(C.LINK_POOL), 3)
+	end
+
+	local pool = link_pools[depth]
+	if pool == nil then
+		pool = oro.Pool { 'oro_link', depth = depth }
+		link_pools[depth] = pool
+	end
+
+	return pool
+end
+
+-- Linkers are cached by compiler configuration and pool,
+-- both of which are looked up on every call (so that each
+-- module's cached evaluation records what they read).
 local exe_linker_cache = {}
 local function link_exe_builder(opts)
-	local linker_key = C.CC or E.CC or DEFAULT_COMPILER
+	local compiler = configure_cc()
+	local pool = default_pool()
 
-	local exe_linker = exe_linker_cache[linker_key]
-	if exe_linker == nil then
-		local compiler = configure_cc()
+	local linkers = exe_linker_cache[compiler]
+	if linkers == nil then
+		linkers = {}
+		exe_linker_cache[compiler] = linkers
+	end
 
+	local exe_linker = linkers[pool or false]
+	if exe_linker == nil then
 		local new_linker = {}
 		for k, v in pairs(compiler) do
 			new_linker[k] = v
 		end
 
-		new_linker.rule = new_linker.rule:clone {
-			depfile = false,
-			description = (
-				'LINK EXE('
-				.. oro.Rule.escapeall(new_linker.compiler_command)
-				.. ') $out'
-			)
+		new_linker.rule = oro.Rule {
+			command = compiler.link_command,
+			pool = pool,
+			description = 'LINK EXE($cc) $out'
 		}
+		new_linker.lto_rules = {}
 
-		exe_linker_cache[linker_key] = new_linker
+		linkers[pool or false] = new_linker
 		exe_linker = new_linker
 	end
 
@@ -64,20 +91,140 @@ local function link_exe_builder(opts)
 		cflags[nil] = exe_linker.variant.flag_debug
 	end
 
-	return exe_linker.rule {
+	local rule = exe_linker.rule
+
+	local lto_mode = lto.mode(opts)
+	if lto_mode ~= nil then
+		-- LTO links run their own parallel jobs
+		local lto_pool = lto.pool()
+		if exe_linker.lto_rules[lto_pool] == nil then
+			exe_linker.lto_rules[lto_pool] = rule:clone { pool = lto_pool }
+		end
+
+		rule = exe_linker.lto_rules[lto_pool]
+		cflags[nil] = exe_linker.variant.ldflag_lto(lto_mode, lto.jobs(), lto.cachedir, lto.linker())
+	end
+
+	local pgo_opt = pgo.check(opts.pgo, 2)
+	if pgo_opt ~= nil then
+		cflags[nil] = exe_linker.variant.ldflag_pgo(pgo_opt.phase)
+	end
+
+	-- `pool` (an oro.Pool{}) overrides either
+	return rule {
 		opts,
 		out = opts.out,
+		pool = opts.pool,
+		cc = exe_linker.compiler_command_args,
 		cflags = cflags
 	}
 end
 
+-- Trains the instrumented executable (passed as `$0`) and
+-- merges its raw profiles into the set's profile. The
+-- profile is only touched if the result changed.
+local pgo_rule = oro.Rule {
+	command = '$command',
+	description = 'PGO $out',
+	restat = '1'
+}
+
+local PGO_OPTIONS = { name = true, cc = true, train = true }
+
+local function pgo_command(variant, set, train)
+	local script = {'rm', '-rf', tostring(set.data), '&&', '"$$0"'}
+	for v in table.flat{train} do
+		script[#script + 1] = tostring(v)
+	end
+	script[#script + 1] = '&&'
+	for v in table.flat{variant.pgo_merge(set.data, tostring(set.profile))} do
+		script[#script + 1] = tostring(v)
+	end
+
+	script = table.concat(script, ' ')
+	if string.find(script, "'", 1, true) then
+		error('link.pgo{} `train` arguments cannot contain single quotes', 3)
+	end
+
+	return {
+		oro.syscall 'write-if-changed', tostring(set.profile), '--',
+		'sh', '-c', "'" .. script .. "'"
+	}
+end
+
+-- Profile-guided optimization workflow: the sources are
+-- compiled twice (instrumented and optimized, in separate
+-- object trees under `.pgo/<name>`), the instrumented
+-- executable is run with the `train` arguments (through
+-- the shell), and `out` is linked from objects optimized
+-- with the resulting profile.
+--
+--     local app, train = link.pgo {
+--         out = B'app',
+--         train = {'--bench', S'input.txt'},
+--         cc = { warn = 'all' },
+--         S'main.c', S'util.c'
+--     }
+--
+-- `cc` holds the options for cc{}; the others are passed
+-- to link.exe{}. Training happens when the profile is
+-- missing; the returned phony re-trains on demand (e.g.
+-- by exporting it), after which the optimized build is
+-- only redone if the profile changed.
+local function link_pgo_builder(opts)
+	if not oro.ispath(opts.out) then
+		error('link.pgo{} requires an `out` Path; got ' .. type.name(opts.out), 2)
+	end
+
+	local cc = require 'cc'
+	local compiler = configure_cc()
+	local set = pgo.new(opts.name or opts.out:basename())
+
+	local function build(phase, out)
+		local ccopts = {}
+		for k, v in pairs(opts.cc or {}) do
+			ccopts[k] = v
+		end
+		ccopts.pgo = set[phase]
+		ccopts[#ccopts + 1] = opts
+
+		local linkopts = {}
+		for k, v in pairs(opts) do
+			if type(k) == 'string' and not PGO_OPTIONS[k] then
+				linkopts[k] = v
+			end
+		end
+		linkopts.out = out
+		linkopts.pgo = set[phase]
+		linkopts[1] = cc(ccopts)
+
+		return link_exe_builder(linkopts)
+	end
+
+	local instrumented = set.generate.objdir:join(opts.out:basename())
+	build('generate', instrumented)
+
+	local command = pgo_command(compiler.variant, set, opts.train)
+
+	pgo_rule {
+		out = {set.profile},
+		-- Stale profiles are fine (and retraining on every
+		-- change would be slow); see the returned phony.
+		in_order = {instrumented},
+		command = {command, instrumented}
+	}
+
+	return build('use', opts.out), oro.phony(command, instrumented)
+end
+
 local function misuse_catch()
 	error([[link{} can't be used directly; use link.exe{} instead]], 2)
 end
 
 return setmetatable(
 	{
-		exe = link_exe_builder
+		exe = link_exe_builder,
+		pgo = link_pgo_builder
 	},
 	{
 		__call = misuse_catch
@@ -18,6 +18,10 @@
 #	endif
 #	ifndef _POSIX_C_SOURCE
 #		define _POSIX_C_SOURCE 200809L
+#	endif
+	/* for syscall(2) and ioctl(2) */
+#	ifndef _DEFAULT_SOURCE
+#		define _DEFAULT_SOURCE 1
 #	endif
 #endif
 
@@ -31,6 +35,7 @@
 #include "./ext/subprocess.h/subprocess.h"
 #include "./ext/rapidstring/include/rapidstring.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -55,6 +60,17 @@
 #	include <sys/types.h>
 #	include <sys/time.h>
 #	include <sys/sendfile.h>
+#	include <sys/wait.h>
+#	include <sys/mman.h>
+#	ifdef __linux__
+#		include <sys/ioctl.h>
+#		include <sys/syscall.h>
+#		ifndef FICLONE
+#			define FICLONE _IOW(0x94, 9, int)
+#		endif
+#	endif
+#	include <poll.h>
+#	include <signal.h>
 #	include <unistd.h>
 #	ifndef O_PATH
 #		define O_PATH 010000000
@@ -66,6 +82,23 @@
 	typedef struct stat oro_stat_t;
 #endif
 
+/*
+	Precompiled Lua sources, generated by `--embed-lua`
+	and compiled in when the `build` script is run with
+	`ORO_BUILD_EMBED` set.
+*/
+#define ORO_EMBEDDED_BOOTSTRAP "<bootstrap>"
+
+struct oro_embedded_lua_s {
+	const char *name;
+	const unsigned char *data;
+	size_t size;
+};
+
+#ifdef ORO_EMBEDDED_LUA
+#	include ORO_EMBEDDED_LUA
+#endif
+
 static int display_traceback(lua_State *L) {
 	/* -, +1 */
 	lua_getglobal(L, "debug");
@@ -76,17 +109,6 @@ static int display_traceback(lua_State *L) {
 	return 1;
 }
 
-static int read_stream_to_rs(FILE *fd, rapidstring *rs) {
-	char buf[4096];
-	size_t nread = -1;
-
-	while ((nread = fread(buf, 1, sizeof(buf), fd)) > 0) {
-		rs_cat_n(rs, buf, nread);
-	}
-
-	return ferror(fd);
-}
-
 static void pushenv(lua_State *L) {
 	/* -, +1 */
 	lua_newtable(L);
@@ -213,6 +235,267 @@ static int split_string(lua_State *L) {
 	return 1;
 }
 
+/*
+	Native path helpers backing `internal.path`.
+
+	POSIX-style paths only, following the semantics of
+	the lua-path based implementations they replace:
+	normalized paths never end in a separator (other
+	than the root itself), and a leading `./` is kept.
+*/
+
+static int path_is_sep(char c) {
+	return c == '/';
+}
+
+static void path_push_normalized(lua_State *L, const char *p, size_t n) {
+	/* -, +1 */
+	if (n == 0) {
+		lua_pushliteral(L, "");
+		return;
+	}
+
+	int absolute = path_is_sep(p[0]);
+
+	/* A normalized path is never longer than its input (+1 for ".") */
+	char *out = malloc(n + 2);
+	size_t *starts = malloc(sizeof(*starts) * (n / 2 + 2));
+	if (out == NULL || starts == NULL) abort(); /* TODO better error message */
+
+	size_t outn = 0;
+	size_t nseg = 0;
+	int leading_dot = 0;
+	int first = 1;
+
+	if (absolute) out[outn++] = '/';
+
+	size_t i = 0;
+	while (i < n) {
+		while (i < n && path_is_sep(p[i])) ++i;
+		if (i == n) break;
+
+		size_t start = i;
+		while (i < n && !path_is_sep(p[i])) ++i;
+		size_t len = i - start;
+
+		int was_first = first;
+		first = 0;
+
+		if (len == 1 && p[start] == '.') {
+			if (!absolute && was_first) {
+				leading_dot = 1;
+			} else {
+				continue;
+			}
+		} else if (len == 2 && p[start] == '.' && p[start + 1] == '.') {
+			size_t real = nseg - (leading_dot ? 1 : 0);
+
+			if (real > 0) {
+				size_t top = starts[nseg - 1];
+				int top_is_parent = (outn - top) == 2 && out[top] == '.' && out[top + 1] == '.';
+
+				if (!top_is_parent) {
+					--nseg;
+					outn = top > 0 && !(absolute && top == 1) ? top - 1 : top;
+					continue;
+				}
+			} else if (absolute) {
+				continue;
+			}
+		}
+
+		if (nseg > 0) out[outn++] = '/';
+		starts[nseg++] = outn;
+		memcpy(&out[outn], &p[start], len);
+		outn += len;
+	}
+
+	if (nseg == 0 && !absolute) {
+		out[outn++] = '.';
+	}
+
+	lua_pushlstring(L, out, outn);
+	free(starts);
+	free(out);
+}
+
+static int lua_path_normalize(lua_State *L) {
+	/* -, +1 */
+	size_t n;
+	const char *p = luaL_checklstring(L, 1, &n);
+	path_push_normalized(L, p, n);
+	return 1;
+}
+
+static int lua_path_join(lua_State *L) {
+	/* -, +1 */
+	/*
+		Joins path segments, skipping nil and empty ones.
+		An absolute segment replaces everything before it.
+		The result is not normalized.
+	*/
+	int nargs = lua_gettop(L);
+	int first = 1;
+
+	for (int i = 1; i <= nargs; i++) {
+		if (lua_isnil(L, i)) continue;
+
+		size_t len;
+		const char *seg = luaL_tolstring(L, i, &len);
+		lua_replace(L, i);
+
+		if (len > 0 && path_is_sep(seg[0])) first = i;
+	}
+
+	luaL_Buffer b;
+	luaL_buffinit(L, &b);
+	int empty = 1;
+	int trailing_sep = 0;
+
+	for (int i = first; i <= nargs; i++) {
+		if (lua_isnil(L, i)) continue;
+
+		size_t len;
+		const char *seg = lua_tolstring(L, i, &len);
+		if (len == 0) continue;
+
+		if (!empty && !trailing_sep) luaL_addchar(&b, '/');
+		luaL_addlstring(&b, seg, len);
+
+		empty = 0;
+		trailing_sep = path_is_sep(seg[len - 1]);
+	}
+
+	luaL_pushresult(&b);
+	return 1;
+}
+
+static size_t path_last_sep(const char *p, size_t n) {
+	/* Returns `n` if there is no separator */
+	for (size_t i = n; i > 0; i--) {
+		if (path_is_sep(p[i - 1])) return i - 1;
+	}
+	return n;
+}
+
+static int lua_path_basename(lua_State *L) {
+	/* -, +1 */
+	size_t n;
+	const char *p = luaL_checklstring(L, 1, &n);
+	size_t sep = path_last_sep(p, n);
+
+	if (sep == n) {
+		lua_pushvalue(L, 1);
+	} else {
+		lua_pushlstring(L, &p[sep + 1], n - sep - 1);
+	}
+
+	return 1;
+}
+
+static int lua_path_dirname(lua_State *L) {
+	/* -, +1 */
+	size_t n;
+	const char *p = luaL_checklstring(L, 1, &n);
+	size_t sep = path_last_sep(p, n);
+
+	lua_pushlstring(L, p, sep == n ? 0 : sep);
+	return 1;
+}
+
+static int lua_path_splitext(lua_State *L) {
+	/* -, +2 */
+	/*
+		Splits off the extension (including the dot); the
+		dot must follow a character that is neither a dot
+		nor a separator (so `.bashrc` has no extension).
+	*/
+	size_t n;
+	const char *p = luaL_checklstring(L, 1, &n);
+
+	for (size_t i = n; i > 0; i--) {
+		char c = p[i - 1];
+
+		if (path_is_sep(c)) break;
+
+		if (c == '.') {
+			if (i >= 2 && p[i - 2] != '.' && !path_is_sep(p[i - 2])) {
+				lua_pushlstring(L, p, i - 1);
+				lua_pushlstring(L, &p[i - 1], n - i + 1);
+				return 2;
+			}
+
+			break;
+		}
+	}
+
+	lua_pushvalue(L, 1);
+	lua_pushliteral(L, "");
+	return 2;
+}
+
+static int lua_path_relpath(lua_State *L) {
+	/* -, +1 */
+	/*
+		relpath(from, to)
+
+		Returns the relative path from the (absolute)
+		directory `from` to the (absolute) path `to`.
+	*/
+	luaL_checkstring(L, 1);
+	luaL_checkstring(L, 2);
+	luaL_argcheck(L, path_is_sep(lua_tostring(L, 1)[0]), 1, "path must be absolute");
+	luaL_argcheck(L, path_is_sep(lua_tostring(L, 2)[0]), 2, "path must be absolute");
+
+	size_t fromn, ton;
+	path_push_normalized(L, lua_tostring(L, 1), lua_rawlen(L, 1));
+	path_push_normalized(L, lua_tostring(L, 2), lua_rawlen(L, 2));
+	const char *from = lua_tolstring(L, -2, &fromn);
+	const char *to = lua_tolstring(L, -1, &ton);
+
+	if (fromn == ton && memcmp(from, to, fromn) == 0) {
+		lua_pushliteral(L, ".");
+		return 1;
+	}
+
+	/* Skip common leading segments */
+	size_t fi = 1;
+	size_t ti = 1;
+	for (;;) {
+		size_t fe = fi;
+		size_t te = ti;
+		while (fe < fromn && !path_is_sep(from[fe])) ++fe;
+		while (te < ton && !path_is_sep(to[te])) ++te;
+
+		if (fe == fi || te == ti) break;
+		if ((fe - fi) != (te - ti) || memcmp(&from[fi], &to[ti], fe - fi) != 0) break;
+
+		fi = fe < fromn ? fe + 1 : fe;
+		ti = te < ton ? te + 1 : te;
+	}
+
+	luaL_Buffer b;
+	luaL_buffinit(L, &b);
+	int empty = 1;
+
+	/* One `..` for each remaining segment of `from` */
+	for (size_t i = fi; i < fromn;) {
+		while (i < fromn && !path_is_sep(from[i])) ++i;
+		if (!empty) luaL_addchar(&b, '/');
+		luaL_addstring(&b, "..");
+		empty = 0;
+		if (i < fromn) ++i;
+	}
+
+	if (ti < ton) {
+		if (!empty) luaL_addchar(&b, '/');
+		luaL_addlstring(&b, &to[ti], ton - ti);
+	}
+
+	luaL_pushresult(&b);
+	return 1;
+}
+
 static int try_access(const char *pathname, int amode) {
 	/* Stub wrapper that calls access(3) without affecting `errno`. */
 	int errno_before = errno;
@@ -309,49 +592,125 @@ static int search_path(lua_State *L) {
 	return 1;
 }
 
-static int execute_process(lua_State *L) {
-	/* -, +3, ERR */
-	int success = 0;
-	int status_code = -1;
-	int should_throw = 1;
-	int nargs;
+static int cpu_count(void) {
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? (int) n : 1;
+#endif
+}
+
+/*
+	Configure-time profiling state (see `internal/profile.lua`),
+	enabled by a non-empty `ORO_PROFILE` other than `0`.
+*/
+struct oro_profile_s {
+	int enabled;
+	lua_Alloc alloc;
+	void *alloc_ud;
+	/* bytes requested from the allocator */
+	uint64_t alloc_bytes;
+	/* `execute`/`execute_many` calls and their wall time */
+	lua_Integer executes;
+	uint64_t execute_ns;
+};
+
+static struct oro_profile_s oro_profile;
+
+static uint64_t monotime_ns(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (uint64_t) ((double) now.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+static void *profile_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+	/*
+		Wraps the state's allocator, counting the bytes
+		requested. When `ptr` is NULL, `osize` holds the
+		kind of object being allocated rather than a size.
+	*/
+	struct oro_profile_s *prof = ud;
+	size_t had = ptr == NULL ? 0 : osize;
+	if (nsize > had) prof->alloc_bytes += nsize - had;
+	return prof->alloc(prof->alloc_ud, ptr, osize, nsize);
+}
+
+static int lua_monotime(lua_State *L) {
+	/* -, +1 */
+	/* Nanoseconds on a monotonic clock */
+	lua_pushinteger(L, (lua_Integer) monotime_ns());
+	return 1;
+}
+
+static int lua_profile_stats(lua_State *L) {
+	/* -, +3 */
+	/*
+		Returns the bytes allocated so far (0 unless
+		profiling), the number of `execute`/`execute_many`
+		calls and the nanoseconds spent in them.
+	*/
+	lua_pushinteger(L, (lua_Integer) oro_profile.alloc_bytes);
+	lua_pushinteger(L, oro_profile.executes);
+	lua_pushinteger(L, (lua_Integer) oro_profile.execute_ns);
+	return 3;
+}
+
+static int spawn_process(lua_State *L, int idx, struct subprocess_s *subprocess) {
+	/* -, +(0|1) */
+	/*
+		Spawns the command described by the table at `idx`
+		(a sequence of arguments plus an optional `env` table).
+
+		Returns 0 on success. Otherwise, returns non-zero and
+		leaves an error message on the stack.
+	*/
 	int r;
+	int nargs;
 	const char **command_line;
-	struct subprocess_s subprocess;
-	FILE *fd;
 
-	luaL_checktype(L, 1, LUA_TTABLE);
-	nargs = luaL_len(L, 1);
-	luaL_argcheck(L, nargs > 0, 1, "argument list cannot be empty");
+	idx = lua_absindex(L, idx);
+	nargs = luaL_len(L, idx);
 
-	if (lua_getfield(L, 1, "raise") != LUA_TNIL) {
-		should_throw = lua_toboolean(L, -1);
+	if (nargs <= 0) {
+		lua_pushliteral(L, "argument list cannot be empty");
+		return 1;
 	}
-	lua_pop(L, 1);
 
-	rapidstring sout;
-	rapidstring serr;
-	rs_init(&sout);
-	rs_init(&serr);
+	luaL_checkstack(L, nargs + 8, "too many subprocess arguments");
 
 	command_line = malloc(sizeof(const char *) * (nargs + 1));
 	if (command_line == NULL) {
-		lua_pushliteral(L, "failed to allocate memory (execute_process)");
-		goto err;
+		lua_pushliteral(L, "failed to allocate memory (spawn_process)");
+		return 1;
 	}
 
+	/*
+		The argument strings are kept on the stack until the subprocess
+		has been created, after which they're no longer needed.
+	*/
 	command_line[nargs] = NULL;
 	for (int i = 0; i < nargs; i++) {
-		lua_geti(L, -i-1, i+1);
+		lua_geti(L, idx, i+1);
 		command_line[i] = lua_tostring(L, -1);
 	}
 
-	r = lua_getfield(L, 1, "env");
+	r = lua_getfield(L, idx, "env");
 	if (r == LUA_TNIL) {
+		lua_pop(L, 1);
 		r = subprocess_create(
 			command_line,
 			subprocess_option_no_window | subprocess_option_inherit_environment,
-			&subprocess
+			subprocess
 		);
 	} else if (r == LUA_TTABLE) {
 		int env_success = 0;
@@ -435,7 +794,7 @@ static int execute_process(lua_State *L) {
 			command_line,
 			subprocess_option_no_window,
 			new_env,
-			&subprocess
+			subprocess
 		);
 
 		/*
@@ -456,445 +815,3886 @@ env_err_free:
 
 		if (!env_success) goto err_free;
 	} else {
+		lua_pop(L, 1);
 		lua_pushliteral(L, "`env` option must either be nil or a table");
 		goto err_free;
 	}
 
 	lua_pop(L, nargs);
+	free(command_line);
 
 	if (r != 0) {
 		lua_pushliteral(L, "failed to create subprocess");
-		goto err_free;
+		return 1;
 	}
 
-	if (lua_getfield(L, 1, "stdin") != LUA_TNIL) {
-		size_t stdin_size;
-		const char *c = lua_tolstring(L, -1, &stdin_size);
+	return 0;
+
+err_free:
+	/* move the error message below the arguments and pop them */
+	lua_insert(L, -nargs - 1);
+	lua_pop(L, nargs);
+	free(command_line);
+	return 1;
+}
 
-		fd = subprocess_stdin(&subprocess);
-		if (fd == NULL) {
-			lua_pushliteral(L, "`stdin` was provided but failed to get stdin file handle for subprocess");
-			goto err_destroy;
-		}
+static int should_raise(lua_State *L, int idx) {
+	/* -, +0 */
+	int should_throw = 1;
 
-		if (fwrite(c, 1, stdin_size, fd) != stdin_size) {
-			lua_pushfstring(L, "failed to write stdin to subprocess: %s", strerror(errno));
-			goto err_destroy;
-		}
+	if (lua_getfield(L, idx, "raise") != LUA_TNIL) {
+		should_throw = lua_toboolean(L, -1);
 	}
 	lua_pop(L, 1);
 
-	r = subprocess_join(&subprocess, &status_code);
-	if (r != 0) {
-		lua_pushliteral(L, "failed to join subprocess");
-		goto err_destroy;
-	}
+	return should_throw;
+}
 
-	fd = subprocess_stdout(&subprocess);
-	if (fd == NULL) {
-		lua_pushliteral(L, "failed to get stdout file handle for subprocess");
-		goto err_destroy;
-	}
+struct process_s {
+	struct subprocess_s subprocess;
+	/* stdin, stdout, stderr (or -1 once closed) */
+	int fds[3];
+	const char *stdin_data;
+	size_t stdin_size;
+	size_t stdin_offset;
+	rapidstring sout;
+	rapidstring serr;
+	int status_code;
+	int should_throw;
+	lua_Integer index;
+};
 
-	r = read_stream_to_rs(fd, &sout);
-	if (r != 0) {
-		lua_pushfstring(L, "failed to read subprocess stdout: %s", strerror(errno));
-		goto err_destroy;
-	}
+static ssize_t write_nosigpipe(int fd, const void *buf, size_t count) {
+	/*
+		write(2), but a closed read end results in EPIPE
+		rather than the harness being killed by SIGPIPE.
 
-	fd = subprocess_stderr(&subprocess);
-	if (fd == NULL) {
-		lua_pushliteral(L, "failed to get stderr file handle for subprocess");
-		goto err_destroy;
+		We can't simply ignore SIGPIPE for the whole process,
+		as ignored signals are inherited by the subprocesses
+		we spawn.
+	*/
+	sigset_t pipeset;
+	sigset_t oldset;
+	sigemptyset(&pipeset);
+	sigaddset(&pipeset, SIGPIPE);
+	sigprocmask(SIG_BLOCK, &pipeset, &oldset);
+
+	ssize_t r = write(fd, buf, count);
+	int saved_errno = errno;
+
+	if (r < 0 && saved_errno == EPIPE && !sigismember(&oldset, SIGPIPE)) {
+		/* consume the (now pending) SIGPIPE before unblocking it */
+		sigset_t pending;
+		sigpending(&pending);
+		if (sigismember(&pending, SIGPIPE)) {
+			struct timespec zero = {0, 0};
+			sigtimedwait(&pipeset, NULL, &zero);
+		}
 	}
 
-	r = read_stream_to_rs(fd, &serr);
-	if (r != 0) {
-		lua_pushfstring(L, "failed to read subprocess stderr: %s", strerror(errno));
-		goto err_destroy;
+	sigprocmask(SIG_SETMASK, &oldset, NULL);
+	errno = saved_errno;
+	return r;
+}
+
+static void close_process_stdin(struct process_s *proc) {
+	if (proc->subprocess.stdin_file != NULL) {
+		fclose(proc->subprocess.stdin_file);
+		proc->subprocess.stdin_file = NULL;
 	}
 
-	if (status_code != 0 && should_throw) {
-		rapidstring errmsg;
-		rs_init(&errmsg);
-		rs_cat(&errmsg, "subprocess exited non-zero:");
-		for (int i = 0; i < nargs; i++) {
-			rs_cat_n(&errmsg, " «", 3);
-			rs_cat(&errmsg, command_line[i]);
-			rs_cat_n(&errmsg, "»", 2);
-		}
-		rs_cat(&errmsg, "\n\n--- STDOUT ------------\n");
-		rs_cat_rs(&errmsg, &sout);
-		rs_cat(&errmsg, "\n--- STDERR ------------\n");
-		rs_cat_rs(&errmsg, &serr);
-		rs_cat_n(&errmsg, "\n", 1);
-		lua_pushlstring(L, rs_data_c(&errmsg), rs_len(&errmsg));
-		rs_free(&errmsg);
-		goto err_destroy;
+	proc->fds[0] = -1;
+}
+
+static int start_process(lua_State *L, int idx, struct process_s *proc) {
+	/* -, +1 */
+	/*
+		Spawns the command table at `idx` and prepares it to be
+		pumped by `pump_processes()`.
+
+		Returns 0 on success, leaving the `stdin` option on the
+		stack (the caller must keep it referenced until the process
+		has finished, since we write from its buffer directly).
+		Otherwise, returns non-zero and leaves an error message
+		on the stack.
+	*/
+	idx = lua_absindex(L, idx);
+
+	proc->stdin_data = NULL;
+	proc->stdin_size = 0;
+	proc->stdin_offset = 0;
+	proc->status_code = -1;
+	proc->should_throw = should_raise(L, idx);
+	rs_init(&proc->sout);
+	rs_init(&proc->serr);
+
+	if (lua_getfield(L, idx, "stdin") != LUA_TNIL) {
+		proc->stdin_data = lua_tolstring(L, -1, &proc->stdin_size);
+		if (proc->stdin_data == NULL) {
+			lua_pop(L, 1);
+			lua_pushliteral(L, "`stdin` option must be a string");
+			return 1;
+		}
 	}
 
-	lua_pushnumber(L, status_code);
-	lua_pushlstring(L, rs_data_c(&sout), rs_len(&sout));
-	lua_pushlstring(L, rs_data_c(&serr), rs_len(&serr));
+	if (spawn_process(L, idx, &proc->subprocess) != 0) {
+		/* remove the `stdin` value from beneath the error message */
+		lua_remove(L, -2);
+		return 1;
+	}
 
-	success = 3;
+	proc->fds[0] = fileno(proc->subprocess.stdin_file);
+	proc->fds[1] = fileno(proc->subprocess.stdout_file);
+	proc->fds[2] = fileno(proc->subprocess.stderr_file);
 
-err_destroy:
-	r = subprocess_destroy(&subprocess);
-	if (r != 0 && success) {
-		success = 0;
-		lua_pushliteral(L, "failed to destroy (cleanup) subprocess");
+	/*
+		subprocess.h's pipes aren't close-on-exec, so without
+		FD_CLOEXEC later siblings (see `execute_many`) would
+		inherit our ends - and e.g. a child reading its stdin
+		wouldn't see EOF until they'd all exited.
+	*/
+	for (int i = 0; i < 3; i++) {
+		int flags = fcntl(proc->fds[i], F_GETFL);
+		int fdflags = fcntl(proc->fds[i], F_GETFD);
+		if (
+			flags == -1 || fcntl(proc->fds[i], F_SETFL, flags | O_NONBLOCK) == -1
+			|| fdflags == -1 || fcntl(proc->fds[i], F_SETFD, fdflags | FD_CLOEXEC) == -1
+		) {
+			lua_pop(L, 1);
+			lua_pushfstring(L, "failed to set up subprocess pipes: %s", strerror(errno));
+			subprocess_terminate(&proc->subprocess);
+			subprocess_destroy(&proc->subprocess);
+			return 1;
+		}
 	}
-err_free:
-	free(command_line);
-	rs_free(&sout);
-	rs_free(&serr);
-err:
-	if (!success) lua_error(L);
-	return success;
-}
 
-static int main_build(int argc, char *argv[]) {
-	int status;
-	const char *root_dir;
-	const char *bin_dir;
-	const char *build_script;
-	const char *bootstrap_script;
-	lua_State *L;
-	int traceback_idx;
+	if (proc->stdin_size == 0) close_process_stdin(proc);
 
-	status = 1;
+	return 0;
+}
 
-	if (argc < 5) {
-		fputs("error: Oro build system called with insufficient arguments\n", stderr);
-		fputs("error: (hint: don't call `.oro/build` directly)\n", stderr);
-		status = 2;
-		goto exit;
-	}
+static int process_running(const struct process_s *proc) {
+	return proc->fds[1] != -1 || proc->fds[2] != -1;
+}
 
-	root_dir = argv[1];
-	bin_dir = argv[2];
-	bootstrap_script = argv[3];
-	build_script = argv[4];
+static int drain_fd(int *fd, rapidstring *rs) {
+	/*
+		Reads everything currently available on `fd` directly
+		into the spare capacity of `rs`, closing (marking as -1)
+		the descriptor upon EOF.
+	*/
+	for (;;) {
+		size_t len = rs_len(rs);
 
-	argv += 5;
-	argc -= 5;
+		if (rs_cap(rs) - len < 16384) {
+			size_t want = rs_cap(rs) * 2;
+			if (want < len + 65536) want = len + 65536;
+			rs_reserve(rs, want);
+		}
 
-	L = luaL_newstate();
+		/* (leaves room for the NUL terminator written by `rs_resize()`) */
+		ssize_t nread = read(*fd, rs_data(rs) + len, rs_cap(rs) - len - 1);
 
-	if (L == NULL) {
-		fputs("error: failed to initialize Lua state\n", stderr);
-		goto exit;
+		if (nread > 0) {
+			rs_resize(rs, len + (size_t) nread);
+		} else if (nread == 0) {
+			*fd = -1;
+			return 0;
+		} else if (errno == EINTR) {
+			continue;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			return 0;
+		} else {
+			*fd = -1;
+			return 1;
+		}
 	}
+}
 
-	luaL_openlibs(L);
+static int pump_processes(lua_State *L, struct process_s *procs, int nprocs, struct pollfd *pfds) {
+	/* -, +(0|1) */
+	/*
+		Waits for any of the running processes' pipes to become ready,
+		then feeds stdin and drains stdout/stderr for each of them.
+		`pfds` must have room for at least `nprocs * 3` entries.
 
-	lua_pushcfunction(L, &display_traceback);
-	traceback_idx = lua_gettop(L);
-
-	lua_newtable(L);
-	{
-		{
-			lua_pushstring(L, "root_dir");
-			lua_pushstring(L, root_dir);
-			lua_rawset(L, -3);
-		}
-		{
-			lua_pushstring(L, "bin_dir");
-			lua_pushstring(L, bin_dir);
-			lua_rawset(L, -3);
+		Returns 0 on success. Otherwise, returns non-zero and
+		leaves an error message on the stack.
+	*/
+	nfds_t npfds = 0;
+
+	for (int i = 0; i < nprocs; i++) {
+		struct process_s *proc = &procs[i];
+		if (!process_running(proc)) continue;
+
+		for (int j = 0; j < 3; j++) {
+			if (proc->fds[j] == -1) continue;
+			pfds[npfds].fd = proc->fds[j];
+			pfds[npfds].events = j == 0 ? POLLOUT : POLLIN;
+			pfds[npfds].revents = 0;
+			++npfds;
 		}
-		{
-			lua_pushstring(L, "build_script");
-			lua_pushstring(L, build_script);
-			lua_rawset(L, -3);
+	}
+
+	if (npfds == 0) return 0;
+
+	if (poll(pfds, npfds, -1) < 0) {
+		if (errno == EINTR) return 0;
+		lua_pushfstring(L, "poll() failed on subprocess pipes: %s", strerror(errno));
+		return 1;
+	}
+
+	nfds_t cur = 0;
+	for (int i = 0; i < nprocs; i++) {
+		struct process_s *proc = &procs[i];
+		if (!process_running(proc)) continue;
+
+		for (int j = 0; j < 3; j++) {
+			if (proc->fds[j] == -1) continue;
+
+			short revents = pfds[cur++].revents;
+			if (revents == 0) continue;
+
+			if (j == 0) {
+				ssize_t written = write_nosigpipe(
+					proc->fds[0],
+					proc->stdin_data + proc->stdin_offset,
+					proc->stdin_size - proc->stdin_offset
+				);
+
+				if (written > 0) {
+					proc->stdin_offset += (size_t) written;
+					if (proc->stdin_offset == proc->stdin_size) close_process_stdin(proc);
+				} else if (written < 0 && errno == EPIPE) {
+					/* the subprocess closed its stdin; it just doesn't get the rest */
+					close_process_stdin(proc);
+				} else if (written < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+					lua_pushfstring(L, "failed to write stdin to subprocess: %s", strerror(errno));
+					close_process_stdin(proc);
+					return 1;
+				}
+			} else if (drain_fd(&proc->fds[j], j == 1 ? &proc->sout : &proc->serr) != 0) {
+				lua_pushfstring(
+					L,
+					"failed to read subprocess %s: %s",
+					j == 1 ? "stdout" : "stderr",
+					strerror(errno)
+				);
+				return 1;
+			}
 		}
-		{
-			lua_pushstring(L, "search_path");
-			lua_pushcfunction(L, search_path);
-			lua_rawset(L, -3);
+	}
+
+	return 0;
+}
+
+static int finish_process(lua_State *L, struct process_s *proc) {
+	/* -, +(0|1) */
+	/*
+		Reaps a process whose output pipes have both been closed.
+
+		Returns 0 on success. Otherwise, returns non-zero and
+		leaves an error message on the stack.
+	*/
+	close_process_stdin(proc);
+
+	if (subprocess_join(&proc->subprocess, &proc->status_code) != 0) {
+		lua_pushliteral(L, "failed to join subprocess");
+		return 1;
+	}
+
+	return 0;
+}
+
+static void kill_process(struct process_s *proc) {
+	/*
+		Stops a process that we've given up on (due to an error)
+		so that joining it in `subprocess_destroy()` won't hang.
+	*/
+	if (process_running(proc)) {
+		subprocess_terminate(&proc->subprocess);
+		proc->fds[1] = -1;
+		proc->fds[2] = -1;
+	}
+
+	close_process_stdin(proc);
+}
+
+static void push_exit_error(lua_State *L, int idx, const rapidstring *sout, const rapidstring *serr) {
+	/* -, +1 */
+	/*
+		Pushes the error message used when the command table at `idx`
+		exits non-zero and the caller asked for it to raise.
+	*/
+	idx = lua_absindex(L, idx);
+	int nargs = luaL_len(L, idx);
+
+	rapidstring errmsg;
+	rs_init(&errmsg);
+	rs_cat(&errmsg, "subprocess exited non-zero:");
+	for (int i = 0; i < nargs; i++) {
+		size_t sz;
+		lua_geti(L, idx, i+1);
+		const char *arg = lua_tolstring(L, -1, &sz);
+		rs_cat_n(&errmsg, " «", 3);
+		if (arg != NULL) rs_cat_n(&errmsg, arg, sz);
+		rs_cat_n(&errmsg, "»", 2);
+		lua_pop(L, 1);
+	}
+	rs_cat(&errmsg, "\n\n--- STDOUT ------------\n");
+	rs_cat_rs(&errmsg, sout);
+	rs_cat(&errmsg, "\n--- STDERR ------------\n");
+	rs_cat_rs(&errmsg, serr);
+	rs_cat_n(&errmsg, "\n", 1);
+	lua_pushlstring(L, rs_data_c(&errmsg), rs_len(&errmsg));
+	rs_free(&errmsg);
+}
+
+static int execute_process(lua_State *L) {
+	/* -, +3, ERR */
+	int success = 0;
+	struct process_s proc;
+	struct pollfd pfds[3];
+
+	uint64_t started = monotime_ns();
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_argcheck(L, luaL_len(L, 1) > 0, 1, "argument list cannot be empty");
+
+	if (start_process(L, 1, &proc) != 0) goto err_free;
+
+	while (process_running(&proc)) {
+		if (pump_processes(L, &proc, 1, pfds) != 0) {
+			kill_process(&proc);
+			goto err_destroy;
 		}
-		{
-			lua_pushstring(L, "execute");
-			lua_pushcfunction(L, execute_process);
-			lua_rawset(L, -3);
+	}
+
+	if (finish_process(L, &proc) != 0) goto err_destroy;
+
+	if (proc.status_code != 0 && proc.should_throw) {
+		push_exit_error(L, 1, &proc.sout, &proc.serr);
+		goto err_destroy;
+	}
+
+	lua_pushnumber(L, proc.status_code);
+	lua_pushlstring(L, rs_data_c(&proc.sout), rs_len(&proc.sout));
+	lua_pushlstring(L, rs_data_c(&proc.serr), rs_len(&proc.serr));
+
+	success = 3;
+
+err_destroy:
+	if (subprocess_destroy(&proc.subprocess) != 0 && success) {
+		success = 0;
+		lua_pushliteral(L, "failed to destroy (cleanup) subprocess");
+	}
+err_free:
+	rs_free(&proc.sout);
+	rs_free(&proc.serr);
+	oro_profile.executes++;
+	oro_profile.execute_ns += monotime_ns() - started;
+	if (!success) lua_error(L);
+	return success;
+}
+
+static int execute_many(lua_State *L) {
+	/* -, +1, ERR */
+	/*
+		Runs a list of command tables (each taking the same
+		options as `execute`) concurrently, at most `jobs` at
+		a time (defaulting to the number of online processors).
+
+		Returns a list of `{status, stdout, stderr}` tables,
+		in the same order as the commands. If any command that
+		didn't opt out via `raise = false` fails, no further
+		commands are started, any still running are stopped,
+		and the first such failure is raised.
+	*/
+	lua_Integer ncommands;
+	lua_Integer next = 1;
+	lua_Integer jobs;
+	struct process_s *slots;
+	struct pollfd *pfds;
+	int count = 0;
+	int failed = 0;
+	int errmsg_idx;
+	int results_idx;
+	int anchors_idx;
+	uint64_t started = monotime_ns();
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	ncommands = luaL_len(L, 1);
+
+	jobs = cpu_count();
+	if (lua_getfield(L, 1, "jobs") != LUA_TNIL) {
+		int isnum;
+		jobs = lua_tointegerx(L, -1, &isnum);
+		luaL_argcheck(L, isnum && jobs > 0, 1, "`jobs` must be a positive integer");
+	}
+	lua_pop(L, 1);
+
+	if (jobs > ncommands) jobs = ncommands > 0 ? ncommands : 1;
+
+	lua_pushnil(L);
+	errmsg_idx = lua_gettop(L);
+
+	lua_createtable(L, (int) ncommands, 0);
+	results_idx = lua_gettop(L);
+
+	/* keeps each running command's stdin string alive */
+	lua_newtable(L);
+	anchors_idx = lua_gettop(L);
+
+	slots = calloc((size_t) jobs, sizeof(*slots));
+	pfds = calloc((size_t) jobs * 3, sizeof(*pfds));
+	if (slots == NULL || pfds == NULL) {
+		free(slots);
+		free(pfds);
+		return luaL_error(L, "failed to allocate memory (execute_many)");
+	}
+
+	/* `index == 0` marks a free slot */
+	for (lua_Integer i = 0; i < jobs; i++) {
+		slots[i].fds[0] = slots[i].fds[1] = slots[i].fds[2] = -1;
+	}
+
+	for (;;) {
+		/* Top up the free slots */
+		for (int i = 0; i < jobs && !failed && next <= ncommands; i++) {
+			struct process_s *proc = &slots[i];
+			if (proc->index != 0) continue;
+
+			if (lua_geti(L, 1, next) != LUA_TTABLE) {
+				lua_pop(L, 1);
+				lua_pushfstring(L, "command #%d must be a table", (int) next);
+				lua_replace(L, errmsg_idx);
+				failed = 1;
+				break;
+			}
+
+			if (start_process(L, -1, proc) != 0) {
+				lua_replace(L, errmsg_idx);
+				lua_pop(L, 1);
+				rs_free(&proc->sout);
+				rs_free(&proc->serr);
+				failed = 1;
+				break;
+			}
+
+			proc->index = next++;
+			lua_seti(L, anchors_idx, proc->index);
+			lua_pop(L, 1);
+			++count;
+			oro_profile.executes++;
 		}
-		{
-			lua_pushstring(L, "split");
-			lua_pushcfunction(L, split_string);
-			lua_rawset(L, -3);
+
+		if (count == 0) break;
+
+		if (failed) {
+			for (int i = 0; i < jobs; i++) {
+				if (slots[i].index != 0) kill_process(&slots[i]);
+			}
+		} else if (pump_processes(L, slots, (int) jobs, pfds) != 0) {
+			lua_replace(L, errmsg_idx);
+			failed = 1;
+			continue;
 		}
-		{
-			lua_pushcfunction(L, &luaopen_lfs);
-			if (lua_pcall(L, 0, 0, traceback_idx) != 0) {
-				fprintf(stderr, "error: failed to load LFS: %s\n", lua_tostring(L, -1));
-				goto exit_close_state;
+
+		/* Reap any commands that have finished */
+		for (int i = 0; i < jobs; i++) {
+			struct process_s *proc = &slots[i];
+			if (proc->index == 0 || process_running(proc)) continue;
+
+			if (finish_process(L, proc) != 0) {
+				if (!failed) lua_replace(L, errmsg_idx);
+				else lua_pop(L, 1);
+				failed = 1;
+			} else if (proc->status_code != 0 && proc->should_throw && !failed) {
+				lua_geti(L, 1, proc->index);
+				push_exit_error(L, -1, &proc->sout, &proc->serr);
+				lua_replace(L, errmsg_idx);
+				lua_pop(L, 1);
+				failed = 1;
 			}
 
-			lua_pushliteral(L, "lfs");
-			lua_getglobal(L, "lfs");
-			lua_rawset(L, -3);
+			lua_createtable(L, 0, 3);
+			lua_pushnumber(L, proc->status_code);
+			lua_setfield(L, -2, "status");
+			lua_pushlstring(L, rs_data_c(&proc->sout), rs_len(&proc->sout));
+			lua_setfield(L, -2, "stdout");
+			lua_pushlstring(L, rs_data_c(&proc->serr), rs_len(&proc->serr));
+			lua_setfield(L, -2, "stderr");
+			lua_seti(L, results_idx, proc->index);
+
 			lua_pushnil(L);
-			lua_setglobal(L, "lfs");
+			lua_seti(L, anchors_idx, proc->index);
+
+			rs_free(&proc->sout);
+			rs_free(&proc->serr);
+
+			if (subprocess_destroy(&proc->subprocess) != 0 && !failed) {
+				lua_pushliteral(L, "failed to destroy (cleanup) subprocess");
+				lua_replace(L, errmsg_idx);
+				failed = 1;
+			}
+
+			proc->index = 0;
+			--count;
 		}
-		{
-			lua_pushstring(L, "env");
-			pushenv(L);
-			lua_rawset(L, -3);
+	}
+
+	free(slots);
+	free(pfds);
+
+	/* (the batch's wall time, not the sum of its commands') */
+	oro_profile.execute_ns += monotime_ns() - started;
+
+	if (failed) {
+		lua_pushvalue(L, errmsg_idx);
+		return lua_error(L);
+	}
+
+	return 1;
+}
+
+static int is_nuclear(lua_State *L, int idx) {
+	/* -, +0 */
+	/*
+		C version of `internal.util.isnuclear`; checks if the
+		value at `idx` has a (possibly masked via `__metatable`)
+		metatable with a `__name` field.
+	*/
+	int nuclear = 0;
+
+	if (!lua_getmetatable(L, idx)) return 0;
+
+	lua_pushliteral(L, "__metatable");
+	if (lua_rawget(L, -2) == LUA_TNIL) {
+		lua_pop(L, 1);
+	} else {
+		lua_remove(L, -2);
+	}
+
+	if (lua_type(L, -1) == LUA_TTABLE) {
+		nuclear = lua_getfield(L, -1, "__name") != LUA_TNIL;
+		lua_pop(L, 1);
+	}
+
+	lua_pop(L, 1);
+	return nuclear;
+}
+
+static void unfreeze_top(lua_State *L) {
+	/* -1, +1 */
+	/*
+		Replaces a frozen proxy (see `internal.util.freeze`) at the
+		top of the stack with the object it wraps. Reading through
+		the proxy would otherwise allocate a new proxy per access.
+	*/
+	if (!lua_getmetatable(L, -1)) return;
+
+	lua_pushliteral(L, "__this");
+	if (lua_rawget(L, -2) == LUA_TNIL) {
+		lua_pop(L, 2);
+	} else {
+		lua_remove(L, -2);
+		lua_remove(L, -2);
+	}
+}
+
+#define ORO_FLAT_ITER_MT "oro.flat"
+
+struct flat_iter_s {
+	lua_Integer *idx;
+	size_t depth;
+	size_t cap;
+};
+
+static int flat_iter_gc(lua_State *L) {
+	struct flat_iter_s *it = luaL_checkudata(L, 1, ORO_FLAT_ITER_MT);
+	free(it->idx);
+	it->idx = NULL;
+	return 0;
+}
+
+static int lua_is_nuclear(lua_State *L) {
+	/* -, +1 */
+	luaL_checkany(L, 1);
+	lua_pushboolean(L, is_nuclear(L, 1));
+	return 1;
+}
+
+static void flat_iter_push(lua_State *L, struct flat_iter_s *it, int stack_idx, lua_Integer start) {
+	/* -1, +0 */
+	if (it->depth == it->cap) {
+		it->cap = it->cap == 0 ? 16 : it->cap * 2;
+		lua_Integer *idx = realloc(it->idx, sizeof(*idx) * it->cap);
+		if (idx == NULL) abort(); /* TODO better error message */
+		it->idx = idx;
+	}
+
+	it->idx[it->depth++] = start;
+	lua_rawseti(L, stack_idx, (lua_Integer) it->depth);
+}
+
+static int flat_iter_next(lua_State *L) {
+	/* -, +1 */
+	/*
+		Upvalues:
+			1 - the iterator state (struct flat_iter_s)
+			2 - the stack of tables being iterated
+	*/
+	struct flat_iter_s *it = lua_touserdata(L, lua_upvalueindex(1));
+	int stack_idx = lua_upvalueindex(2);
+
+	int base = lua_gettop(L);
+
+	for (;;) {
+		lua_settop(L, base);
+
+		if (it->depth == 0) return 0;
+
+		lua_rawgeti(L, stack_idx, (lua_Integer) it->depth);
+		lua_geti(L, -1, it->idx[it->depth - 1]++);
+		lua_remove(L, -2);
+
+		if (lua_isnil(L, -1)) {
+			lua_pushnil(L);
+			lua_rawseti(L, stack_idx, (lua_Integer) it->depth);
+			--it->depth;
+			continue;
 		}
-		{
-			lua_pushstring(L, "arg");
-			lua_newtable(L);
-			for (int i = 0; i < argc; i++) {
-				lua_pushstring(L, argv[i]);
-				lua_rawseti(L, -2, i + 1);
+
+		/*
+			Descend into (non-nuclear) tables. Note that, as with
+			the original Lua implementation, a nil first item does
+			not end a nested table's iteration; only later ones do.
+		*/
+		int skip = 0;
+		while (lua_type(L, -1) == LUA_TTABLE && !is_nuclear(L, -1)) {
+			lua_len(L, -1);
+			lua_pushinteger(L, 0);
+			int empty = lua_compare(L, -2, -1, LUA_OPEQ);
+			lua_pop(L, 2);
+
+			if (empty) {
+				skip = 1;
+				break;
 			}
-			lua_rawset(L, -3);
+
+			lua_pushvalue(L, -1);
+			flat_iter_push(L, it, stack_idx, 2);
+			lua_geti(L, -1, 1);
+			lua_remove(L, -2);
+		}
+
+		if (skip || lua_isnil(L, -1)) continue;
+
+		return 1;
+	}
+}
+
+static int lua_flat(lua_State *L) {
+	/* -, +1 */
+	/*
+		C version of `internal.util.flat`; returns an iterator
+		over all (non-nil) leaf values of a nested table
+		structure, not descending into "nuclear" objects.
+	*/
+	lua_settop(L, 1);
+
+	struct flat_iter_s *it = lua_newuserdatauv(L, sizeof(*it), 0);
+	it->idx = NULL;
+	it->depth = 0;
+	it->cap = 0;
+
+	if (luaL_newmetatable(L, ORO_FLAT_ITER_MT)) {
+		lua_pushcfunction(L, &flat_iter_gc);
+		lua_setfield(L, -2, "__gc");
+	}
+	lua_setmetatable(L, -2);
+
+	lua_createtable(L, 8, 0);
+
+	/* Wrap the argument just like `flat({t})` */
+	lua_createtable(L, 1, 0);
+	lua_pushvalue(L, 1);
+	lua_rawseti(L, -2, 1);
+	flat_iter_push(L, it, lua_gettop(L) - 1, 1);
+
+	lua_pushcclosure(L, &flat_iter_next, 2);
+	return 1;
+}
+
+struct ninja_writer_s {
+	lua_State *L;
+	rapidstring out;
+};
+
+static void ninja_emit_escaped(struct ninja_writer_s *w, const char *str, size_t len, int colon) {
+	/*
+		Escapes spaces and newlines (and colons, if `colon` is set)
+		with `$`. Dollar signs themselves are left alone so that
+		variables (e.g. `$in`) pass through.
+	*/
+	size_t start = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		char c = str[i];
+		if (c == ' ' || c == '\n' || (colon && c == ':')) {
+			rs_cat_n(&w->out, &str[start], i - start);
+			rs_cat_n(&w->out, "$", 1);
+			start = i;
+		}
+	}
+
+	rs_cat_n(&w->out, &str[start], len - start);
+}
+
+static void ninja_emit_tostring(struct ninja_writer_s *w, int idx, int escape, int colon) {
+	/* -, +0 */
+	size_t len;
+	const char *str = luaL_tolstring(w->L, idx, &len);
+
+	if (escape) {
+		ninja_emit_escaped(w, str, len, colon);
+	} else {
+		rs_cat_n(&w->out, str, len);
+	}
+
+	lua_pop(w->L, 1);
+}
+
+static void ninja_emit_flat(struct ninja_writer_s *w, int colon, int skip_false, const char *prefix) {
+	/* -1, +0 */
+	/*
+		Walks the value at the top of the stack the same way
+		`internal.util.flat` would, emitting each (escaped) item
+		preceded by `prefix`.
+	*/
+	lua_State *L = w->L;
+
+	luaL_checkstack(L, 4, "build configuration nested too deeply");
+	unfreeze_top(L);
+
+	int t = lua_type(L, -1);
+
+	if (t == LUA_TNIL || (skip_false && t == LUA_TBOOLEAN && !lua_toboolean(L, -1))) {
+		/* skip */
+	} else if (t == LUA_TTABLE && !is_nuclear(L, -1)) {
+		lua_len(L, -1);
+		lua_Integer len = lua_tointeger(L, -1);
+		lua_pop(L, 1);
+
+		if (len != 0) {
+			for (lua_Integer i = 1;; i++) {
+				if (lua_geti(L, -1, i) == LUA_TNIL) {
+					lua_pop(L, 1);
+					break;
+				}
+
+				ninja_emit_flat(w, colon, skip_false, prefix);
+			}
+		}
+	} else {
+		rs_cat(&w->out, prefix);
+		ninja_emit_tostring(w, -1, 1, colon);
+	}
+
+	lua_pop(L, 1);
+}
+
+static void ninja_emit_value(struct ninja_writer_s *w) {
+	/* -1, +0 */
+	/*
+		Emits a rule or build variable value (the `emit()` helper
+		of the former Lua writer): lists are flattened and escaped,
+		anything else is emitted verbatim.
+	*/
+	lua_State *L = w->L;
+
+	unfreeze_top(L);
+
+	if (lua_type(L, -1) == LUA_TTABLE && !is_nuclear(L, -1)) {
+		ninja_emit_flat(w, 0, 0, " ");
+		return;
+	}
+
+	if (!lua_isnil(L, -1)) {
+		rs_cat_n(&w->out, " ", 1);
+		ninja_emit_tostring(w, -1, 0, 0);
+	}
+
+	lua_pop(L, 1);
+}
+
+struct ninja_key_s {
+	const char *str;
+	size_t len;
+};
+
+static int ninja_key_compare(const void *a, const void *b) {
+	const struct ninja_key_s *ka = a;
+	const struct ninja_key_s *kb = b;
+	size_t len = ka->len < kb->len ? ka->len : kb->len;
+	int r = memcmp(ka->str, kb->str, len);
+	if (r != 0) return r;
+	return (ka->len > kb->len) - (ka->len < kb->len);
+}
+
+static struct ninja_key_s * ninja_sorted_keys(lua_State *L, int idx, size_t *count) {
+	/* -, +0 */
+	/*
+		Returns the string keys of the table at `idx`, sorted,
+		so that output doesn't depend on hash iteration order.
+		The strings are anchored by the table itself.
+	*/
+	size_t n = 0;
+	size_t cap = 16;
+	struct ninja_key_s *keys = malloc(sizeof(*keys) * cap);
+	if (keys == NULL) abort(); /* TODO better error message */
+
+	idx = lua_absindex(L, idx);
+
+	lua_pushnil(L);
+	while (lua_next(L, idx)) {
+		lua_pop(L, 1);
+
+		if (lua_type(L, -1) != LUA_TSTRING) continue;
+
+		if (n == cap) {
+			cap *= 2;
+			keys = realloc(keys, sizeof(*keys) * cap);
+			if (keys == NULL) abort(); /* TODO better error message */
+		}
+
+		keys[n].str = lua_tolstring(L, -1, &keys[n].len);
+		++n;
+	}
+
+	qsort(keys, n, sizeof(*keys), &ninja_key_compare);
+
+	*count = n;
+	return keys;
+}
+
+static void ninja_emit_pools(struct ninja_writer_s *w, int pools_idx) {
+	/* -, +0 */
+	/* `pools` maps pool names to their depths */
+	lua_State *L = w->L;
+	size_t npools;
+	struct ninja_key_s *pools = ninja_sorted_keys(L, pools_idx, &npools);
+
+	for (size_t i = 0; i < npools; i++) {
+		rs_cat(&w->out, "\n\npool ");
+		rs_cat_n(&w->out, pools[i].str, pools[i].len);
+		rs_cat(&w->out, "\n  depth = ");
+
+		lua_pushlstring(L, pools[i].str, pools[i].len);
+		lua_rawget(L, pools_idx);
+		ninja_emit_tostring(w, -1, 0, 0);
+		lua_pop(L, 1);
+	}
+
+	free(pools);
+}
+
+static void ninja_emit_rules(struct ninja_writer_s *w, int rules_idx) {
+	/* -, +0 */
+	lua_State *L = w->L;
+	size_t nrules;
+	struct ninja_key_s *rules = ninja_sorted_keys(L, rules_idx, &nrules);
+
+	for (size_t i = 0; i < nrules; i++) {
+		rs_cat(&w->out, "\n\nrule ");
+		rs_cat_n(&w->out, rules[i].str, rules[i].len);
+
+		lua_pushlstring(L, rules[i].str, rules[i].len);
+		lua_rawget(L, rules_idx);
+		unfreeze_top(L);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		int opts_idx = lua_gettop(L);
+
+		size_t nopts;
+		struct ninja_key_s *opts = ninja_sorted_keys(L, opts_idx, &nopts);
+
+		for (size_t j = 0; j < nopts; j++) {
+			rs_cat(&w->out, "\n  ");
+			rs_cat_n(&w->out, opts[j].str, opts[j].len);
+			rs_cat(&w->out, " =");
+
+			lua_pushlstring(L, opts[j].str, opts[j].len);
+			lua_gettable(L, opts_idx);
+			ninja_emit_value(w);
+		}
+
+		free(opts);
+		lua_pop(L, 1);
+	}
+
+	free(rules);
+}
+
+static void ninja_emit_subninjas(struct ninja_writer_s *w, int subninjas_idx) {
+	/* -, +0 */
+	/* `subninjas` lists the (build directory relative) files to include */
+	lua_State *L = w->L;
+	lua_Integer nsubninjas = luaL_len(L, subninjas_idx);
+
+	if (nsubninjas == 0) return;
+
+	rs_cat(&w->out, "\n");
+
+	for (lua_Integer i = 1; i <= nsubninjas; i++) {
+		rs_cat(&w->out, "\nsubninja ");
+		lua_geti(L, subninjas_idx, i);
+		unfreeze_top(L);
+		ninja_emit_tostring(w, -1, 1, 0);
+		lua_pop(L, 1);
+	}
+}
+
+static int ninja_emit_build_list(struct ninja_writer_s *w, int opts_idx, const char *key, const char *separator) {
+	/* -, +0 */
+	/*
+		Emits e.g. ` | <implicit outputs...>` if `key` is set.
+		Returns whether it was.
+	*/
+	lua_State *L = w->L;
+
+	if (lua_getfield(L, opts_idx, key) == LUA_TNIL) {
+		lua_pop(L, 1);
+		return 0;
+	}
+
+	rs_cat(&w->out, separator);
+	ninja_emit_flat(w, 1, 1, " ");
+	return 1;
+}
+
+static void ninja_emit_builds(struct ninja_writer_s *w, int builds_idx) {
+	/* -, +0 */
+	lua_State *L = w->L;
+	lua_Integer nbuilds = luaL_len(L, builds_idx);
+
+	for (lua_Integer i = 1; i <= nbuilds; i++) {
+		lua_geti(L, builds_idx, i);
+		int build_idx = lua_gettop(L);
+
+		lua_getfield(L, build_idx, "rule");
+		lua_getfield(L, build_idx, "opts");
+		unfreeze_top(L);
+		luaL_checktype(L, -1, LUA_TTABLE);
+		int opts_idx = lua_gettop(L);
+
+		if (lua_isnil(L, -2)) {
+			luaL_error(L, "build #%d is missing its rule name", (int) i);
+		}
+
+		int ignore_out, ignore_out_implicit, ignore_in_implicit, ignore_in_order;
+
+		rs_cat(&w->out, "\n\nbuild");
+
+		ignore_out = ninja_emit_build_list(w, opts_idx, "out", "");
+		ignore_out_implicit = ninja_emit_build_list(w, opts_idx, "out_implicit", " |");
+
+		rs_cat(&w->out, ": ");
+		ninja_emit_tostring(w, -2, 0, 0);
+
+		lua_pushvalue(L, opts_idx);
+		ninja_emit_flat(w, 1, 1, " ");
+
+		ignore_in_implicit = ninja_emit_build_list(w, opts_idx, "in_implicit", " |");
+		ignore_in_order = ninja_emit_build_list(w, opts_idx, "in_order", " ||");
+
+		size_t nopts;
+		struct ninja_key_s *opts = ninja_sorted_keys(L, opts_idx, &nopts);
+
+		for (size_t j = 0; j < nopts; j++) {
+			const char *k = opts[j].str;
+
+			if (
+				(ignore_out && strcmp(k, "out") == 0)
+				|| (ignore_out_implicit && strcmp(k, "out_implicit") == 0)
+				|| (ignore_in_implicit && strcmp(k, "in_implicit") == 0)
+				|| (ignore_in_order && strcmp(k, "in_order") == 0)
+			) {
+				continue;
+			}
+
+			rs_cat(&w->out, "\n  ");
+			rs_cat_n(&w->out, k, opts[j].len);
+			rs_cat(&w->out, " =");
+
+			lua_pushlstring(L, k, opts[j].len);
+			lua_gettable(L, opts_idx);
+			ninja_emit_value(w);
+		}
+
+		free(opts);
+		lua_pop(L, 3);
+	}
+}
+
+static void ninja_emit_defaults(struct ninja_writer_s *w, int defaults_idx) {
+	/* -, +0 */
+	lua_State *L = w->L;
+	lua_Integer ndefaults = luaL_len(L, defaults_idx);
+
+	if (ndefaults == 0) return;
+
+	rs_cat(&w->out, "\n");
+
+	for (lua_Integer i = 1; i <= ndefaults; i++) {
+		rs_cat(&w->out, "\ndefault ");
+		lua_geti(L, defaults_idx, i);
+		unfreeze_top(L);
+		ninja_emit_tostring(w, -1, 1, 0);
+		lua_pop(L, 1);
+	}
+}
+
+static int write_if_changed(const char *filepath, const char *data, size_t len) {
+	/*
+		Writes `data` to `filepath` via a temporary file that is
+		renamed into place, unless the file already has exactly
+		those contents (in which case it isn't touched at all).
+
+		Returns 1 if written, 0 if unchanged, or -1 on error
+		(with `errno` set).
+	*/
+	FILE *fd = fopen(filepath, "rb");
+	if (fd != NULL) {
+		int same = 0;
+		oro_stat_t stats;
+
+		if (fstat(fileno(fd), &stats) == 0 && (size_t) stats.st_size == len) {
+			char *existing = malloc(len + 1);
+			if (existing != NULL) {
+				same = fread(existing, 1, len, fd) == len && memcmp(existing, data, len) == 0;
+				free(existing);
+			}
+		}
+
+		fclose(fd);
+
+		if (same) return 0;
+	}
+
+	size_t pathlen = strlen(filepath);
+	char *tmppath = malloc(pathlen + sizeof(".tmp"));
+	if (tmppath == NULL) return -1;
+	memcpy(tmppath, filepath, pathlen);
+	memcpy(&tmppath[pathlen], ".tmp", sizeof(".tmp"));
+
+	fd = fopen(tmppath, "wb");
+	if (fd == NULL) goto err_free;
+
+	if (fwrite(data, 1, len, fd) != len) {
+		int saved_errno = errno;
+		fclose(fd);
+		errno = saved_errno;
+		goto err_unlink;
+	}
+
+	if (fclose(fd) != 0) goto err_unlink;
+
+	if (rename(tmppath, filepath) != 0) goto err_unlink;
+
+	free(tmppath);
+	return 1;
+
+err_unlink:
+	{
+		int saved_errno = errno;
+		unlink(tmppath);
+		errno = saved_errno;
+	}
+err_free:
+	free(tmppath);
+	return -1;
+}
+
+static int write_ninja(lua_State *L) {
+	/* -, +1, ERR */
+	/*
+		write_ninja(path, rules, builds, defaults[, pools[, subninjas]])
+
+		Renders a Ninja build file from the tables kept by
+		`internal.ninja` into a single buffer and writes it
+		to `path`, leaving the file untouched if its contents
+		wouldn't change (so Ninja doesn't need to reload it).
+		Included files (`subninjas`) follow the rules, which
+		they can use.
+
+		Returns whether the file was (re-)written.
+	*/
+	const char *filepath = luaL_checkstring(L, 1);
+	luaL_checktype(L, 2, LUA_TTABLE);
+	luaL_checktype(L, 3, LUA_TTABLE);
+	luaL_checktype(L, 4, LUA_TTABLE);
+	if (!lua_isnoneornil(L, 5)) luaL_checktype(L, 5, LUA_TTABLE);
+	if (!lua_isnoneornil(L, 6)) luaL_checktype(L, 6, LUA_TTABLE);
+
+	struct ninja_writer_s w;
+	w.L = L;
+	rs_init(&w.out);
+	rs_reserve(&w.out, 1 << 20);
+
+	rs_cat(&w.out, "#\n# THIS IS A GENERATED BUILD CONFIGURATION");
+	rs_cat(&w.out, "\n# DO NOT MANUALLY EDIT!\n#");
+	rs_cat(&w.out, "\n\nninja_required_version = 1.1");
+
+	if (lua_istable(L, 5)) ninja_emit_pools(&w, 5);
+	ninja_emit_rules(&w, 2);
+	if (lua_istable(L, 6)) ninja_emit_subninjas(&w, 6);
+	ninja_emit_builds(&w, 3);
+	ninja_emit_defaults(&w, 4);
+
+	rs_cat(&w.out, "\n\n# END OF BUILD SCRIPT\n");
+
+	int r = write_if_changed(filepath, rs_data_c(&w.out), rs_len(&w.out));
+	rs_free(&w.out);
+
+	if (r < 0) {
+		return luaL_error(L, "failed to write Ninja file: %s: %s", filepath, strerror(errno));
+	}
+
+	lua_pushboolean(L, r);
+	return 1;
+}
+
+#define ORO_CHUNK_CACHE_MAGIC "ORO-LUAC-1\n"
+
+static char * read_whole_file(const char *filepath, size_t *len) {
+	/*
+		Reads an entire file into a malloc'd buffer.
+		Returns NULL (with `errno` set) on failure.
+	*/
+	FILE *fd = fopen(filepath, "rb");
+	if (fd == NULL) return NULL;
+
+	size_t cap = 4096;
+	size_t n = 0;
+	char *data = malloc(cap);
+	if (data == NULL) goto err_close;
+
+	for (;;) {
+		if (n == cap) {
+			cap *= 2;
+			char *newdata = realloc(data, cap);
+			if (newdata == NULL) goto err_free;
+			data = newdata;
+		}
+
+		size_t r = fread(&data[n], 1, cap - n, fd);
+		n += r;
+
+		if (r == 0) {
+			if (ferror(fd)) goto err_free;
+			break;
+		}
+	}
+
+	fclose(fd);
+	*len = n;
+	return data;
+
+err_free:
+	{
+		int saved_errno = errno;
+		free(data);
+		errno = saved_errno;
+	}
+err_close:
+	{
+		int saved_errno = errno;
+		fclose(fd);
+		errno = saved_errno;
+	}
+	return NULL;
+}
+
+static uint64_t fnv1a64(const char *data, size_t len, uint64_t hash) {
+	for (size_t i = 0; i < len; i++) {
+		hash ^= (unsigned char) data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+#define ORO_FNV1A64_INIT 0xcbf29ce484222325ULL
+
+static int hash_string(lua_State *L) {
+	/* -, +1 */
+	/*
+		hash_string(str)
+
+		Returns the (64-bit FNV-1a) hash of `str` as 16
+		hexadecimal digits. Not cryptographic; used to key
+		caches by file contents.
+	*/
+	size_t n;
+	const char *str = luaL_checklstring(L, 1, &n);
+	uint64_t hash = fnv1a64(str, n, ORO_FNV1A64_INIT);
+
+	char hex[17];
+	snprintf(hex, sizeof(hex), "%016llx", (unsigned long long) hash);
+	lua_pushstring(L, hex);
+	return 1;
+}
+
+static int dump_to_rs(lua_State *L, const void *p, size_t sz, void *ud) {
+	(void) L;
+	rs_cat_n((rapidstring *) ud, p, sz);
+	return 0;
+}
+
+static int load_cached(lua_State *L) {
+	/* -, +2 */
+	/*
+		load_cached(path, cache_dir, env)
+
+		Like `loadfile(path, 'bt', env)` but keeps the compiled
+		chunk (`lua_dump` output) in `cache_dir`, keyed by the
+		(absolute) path and a hash of the source text. Later
+		loads of an unchanged file skip the parser entirely.
+
+		Returns the chunk and whether it came from the cache,
+		or nil and an error message.
+	*/
+	size_t pathn;
+	const char *filepath = luaL_checklstring(L, 1, &pathn);
+	const char *cache_dir = luaL_checkstring(L, 2);
+	luaL_checkany(L, 3);
+
+	size_t srcn;
+	char *src = read_whole_file(filepath, &srcn);
+	if (src == NULL) {
+		lua_pushnil(L);
+		lua_pushfstring(L, "cannot open %s: %s", filepath, strerror(errno));
+		return 2;
+	}
+
+	uint64_t path_hash = fnv1a64(filepath, pathn, ORO_FNV1A64_INIT);
+	uint64_t src_hash = fnv1a64(src, srcn, ORO_FNV1A64_INIT);
+
+	/*
+		The cache entry header repeats the full path so
+		that (unlikely) path hash collisions are caught.
+	*/
+	rapidstring header;
+	rs_init(&header);
+	rs_cat(&header, ORO_CHUNK_CACHE_MAGIC);
+	rs_cat_n(&header, filepath, pathn + 1);
+	rs_cat_n(&header, (const char *) &src_hash, sizeof(src_hash));
+	rs_cat_n(&header, (const char *) &srcn, sizeof(srcn));
+
+	const char *cache_path = lua_pushfstring(L, "%s/%016llx.luac", cache_dir, (unsigned long long) path_hash);
+	lua_pushfstring(L, "@%s", filepath);
+	int cache_path_idx = lua_gettop(L) - 1;
+	int chunkname_idx = lua_gettop(L);
+
+	int hit = 0;
+	size_t cachedn;
+	char *cached = read_whole_file(cache_path, &cachedn);
+
+	if (
+		cached != NULL
+		&& cachedn > rs_len(&header)
+		&& memcmp(cached, rs_data_c(&header), rs_len(&header)) == 0
+	) {
+		/*
+			A mismatched Lua version (etc.) makes the load
+			fail; treat that like any other stale entry.
+		*/
+		const char *chunk = &cached[rs_len(&header)];
+		size_t chunkn = cachedn - rs_len(&header);
+
+		if (luaL_loadbufferx(L, chunk, chunkn, lua_tostring(L, chunkname_idx), "b") == LUA_OK) {
+			hit = 1;
+		} else {
+			lua_pop(L, 1);
+		}
+	}
+
+	free(cached);
+
+	if (!hit) {
+		if (luaL_loadbufferx(L, src, srcn, lua_tostring(L, chunkname_idx), "bt") != LUA_OK) {
+			free(src);
+			rs_free(&header);
+			lua_pushnil(L);
+			lua_insert(L, -2);
+			return 2;
+		}
+
+		rapidstring out;
+		rs_init(&out);
+		rs_cat_n(&out, rs_data_c(&header), rs_len(&header));
+
+		/*
+			Debug info is kept so that errors still
+			point at the right file and line.
+		*/
+		if (lua_dump(L, &dump_to_rs, &out, 0) == 0) {
+			if (write_if_changed(cache_path, rs_data_c(&out), rs_len(&out)) < 0) {
+				fprintf(stderr, "warning: failed to write script cache: %s: %s\n", cache_path, strerror(errno));
+			}
+		}
+
+		rs_free(&out);
+	}
+
+	free(src);
+	rs_free(&header);
+
+	/* Set the chunk's environment (its first upvalue) */
+	lua_pushvalue(L, 3);
+	if (lua_setupvalue(L, -2, 1) == NULL) {
+		lua_pop(L, 1);
+	}
+
+	lua_remove(L, chunkname_idx);
+	lua_remove(L, cache_path_idx);
+
+	lua_pushboolean(L, hit);
+	return 2;
+}
+
+#ifdef ORO_EMBEDDED_LUA
+static const struct oro_embedded_lua_s * find_embedded_lua(const char *name) {
+	for (const struct oro_embedded_lua_s *mod = oro_embedded_lua; mod->name != NULL; mod++) {
+		if (strcmp(mod->name, name) == 0) return mod;
+	}
+
+	return NULL;
+}
+
+static int load_embedded_lua(lua_State *L, const struct oro_embedded_lua_s *mod) {
+	/* -, +1 */
+	return luaL_loadbufferx(L, (const char *) mod->data, mod->size, mod->name, "b");
+}
+
+static int embedded_searcher(lua_State *L) {
+	/* -, +(1|2), ERR */
+	/*
+		`package.searchers` entry that serves the harness's
+		own modules from the bytecode compiled into the binary
+		(see `--embed-lua`), skipping the filesystem entirely.
+	*/
+	const char *name = luaL_checkstring(L, 1);
+	const struct oro_embedded_lua_s *mod = find_embedded_lua(name);
+
+	if (mod == NULL) {
+		lua_pushfstring(L, "no embedded module '%s'", name);
+		return 1;
+	}
+
+	if (load_embedded_lua(L, mod) != LUA_OK) {
+		return luaL_error(L, "error loading embedded module '%s':\n\t%s", name, lua_tostring(L, -1));
+	}
+
+	lua_pushliteral(L, ":embedded:");
+	return 2;
+}
+#endif
+
+#ifndef _WIN32
+struct embed_writer_s {
+	lua_State *L;
+	FILE *out;
+	rapidstring table;
+	size_t count;
+	int status;
+};
+
+static void embed_lua_file(struct embed_writer_s *w, const char *filepath, const char *modname) {
+	/*
+		Compiles `filepath` and writes its bytecode to the
+		generated header as an array registered under `modname`.
+	*/
+	lua_State *L = w->L;
+
+	if (luaL_loadfilex(L, filepath, "t") != LUA_OK) {
+		fprintf(stderr, "embed-lua: %s\n", lua_tostring(L, -1));
+		lua_pop(L, 1);
+		w->status = 1;
+		return;
+	}
+
+	rapidstring bc;
+	rs_init(&bc);
+	lua_dump(L, &dump_to_rs, &bc, 0);
+	lua_pop(L, 1);
+
+	fprintf(w->out, "\n/* %s */\nstatic const unsigned char oro_embedded_%zu[] = {", filepath, w->count);
+
+	const unsigned char *data = (const unsigned char *) rs_data_c(&bc);
+	for (size_t i = 0; i < rs_len(&bc); i++) {
+		fprintf(w->out, "%s0x%02x,", (i % 16) == 0 ? "\n\t" : "", data[i]);
+	}
+
+	fputs("\n};\n", w->out);
+
+	lua_pushfstring(L, "\t{ \"%s\", oro_embedded_%d, sizeof(oro_embedded_%d) },\n", modname, (int) w->count, (int) w->count);
+	rs_cat(&w->table, lua_tostring(L, -1));
+	lua_pop(L, 1);
+
+	++w->count;
+	rs_free(&bc);
+}
+
+static void embed_lua_dir(struct embed_writer_s *w, const char *dirpath, const char *modprefix) {
+	/*
+		Recursively embeds every `*.lua` file under `dirpath`.
+		Module names follow `package.path` conventions:
+		`a/b.lua` is `a.b` and `a/_.lua` is `a`.
+	*/
+	DIR *dir = opendir(dirpath);
+	if (dir == NULL) {
+		fprintf(stderr, "embed-lua: opendir(): %s: %s\n", strerror(errno), dirpath);
+		w->status = 1;
+		return;
+	}
+
+	struct dirent *ent;
+	while ((ent = readdir(dir)) != NULL) {
+		const char *name = ent->d_name;
+		if (name[0] == '.') continue;
+
+		rapidstring path;
+		rs_init(&path);
+		rs_cat(&path, dirpath);
+		rs_cat(&path, "/");
+		rs_cat(&path, name);
+
+		rapidstring modname;
+		rs_init(&modname);
+		rs_cat(&modname, modprefix);
+
+		oro_stat_t stats;
+		if (oro_stat(rs_data_c(&path), &stats) != 0) {
+			fprintf(stderr, "embed-lua: stat(): %s: %s\n", strerror(errno), rs_data_c(&path));
+			w->status = 1;
+		} else if (S_ISDIR(stats.st_mode)) {
+			if (rs_len(&modname) > 0) rs_cat(&modname, ".");
+			rs_cat(&modname, name);
+			embed_lua_dir(w, rs_data_c(&path), rs_data_c(&modname));
+		} else {
+			size_t namelen = strlen(name);
+			if (namelen > 4 && strcmp(&name[namelen - 4], ".lua") == 0) {
+				if (strcmp(name, "_.lua") != 0) {
+					if (rs_len(&modname) > 0) rs_cat(&modname, ".");
+					rs_cat_n(&modname, name, namelen - 4);
+				}
+
+				embed_lua_file(w, rs_data_c(&path), rs_data_c(&modname));
+			}
+		}
+
+		rs_free(&modname);
+		rs_free(&path);
+	}
+
+	closedir(dir);
+}
+
+static int main_embed_lua(int argc, char *argv[]) {
+	/*
+		--embed-lua <root_dir> <out_header>
+
+		Precompiles the harness's own Lua sources (the bootstrap
+		script, `internal/` and lua-path) into a C header that
+		is then compiled into the harness (`-DORO_EMBEDDED_LUA`).
+	*/
+	if (argc != 3) {
+		fputs("usage: --embed-lua <root_dir> <out_header>\n", stderr);
+		return 2;
+	}
+
+	const char *root_dir = argv[1];
+	const char *out_path = argv[2];
+
+	struct embed_writer_s w;
+	w.count = 0;
+	w.status = 0;
+
+	w.L = luaL_newstate();
+	if (w.L == NULL) {
+		fputs("error: failed to initialize Lua state\n", stderr);
+		return 1;
+	}
+
+	w.out = fopen(out_path, "wb");
+	if (w.out == NULL) {
+		fprintf(stderr, "embed-lua: fopen(): %s: %s\n", strerror(errno), out_path);
+		lua_close(w.L);
+		return 1;
+	}
+
+	rs_init(&w.table);
+
+	fputs("/* GENERATED BY `oro-build --embed-lua`; DO NOT EDIT! */\n", w.out);
+
+	lua_pushfstring(w.L, "%s/oro-build.lua", root_dir);
+	embed_lua_file(&w, lua_tostring(w.L, -1), ORO_EMBEDDED_BOOTSTRAP);
+	lua_pop(w.L, 1);
+
+	lua_pushfstring(w.L, "%s/internal", root_dir);
+	embed_lua_dir(&w, lua_tostring(w.L, -1), "internal");
+	lua_pop(w.L, 1);
+
+	lua_pushfstring(w.L, "%s/ext/lua-path/lua", root_dir);
+	embed_lua_dir(&w, lua_tostring(w.L, -1), "");
+	lua_pop(w.L, 1);
+
+	fputs("\nstatic const struct oro_embedded_lua_s oro_embedded_lua[] = {\n", w.out);
+	fputs(rs_data_c(&w.table), w.out);
+	fputs("\t{ NULL, NULL, 0 }\n};\n", w.out);
+
+	rs_free(&w.table);
+	lua_close(w.L);
+
+	if (fclose(w.out) != 0) {
+		fprintf(stderr, "embed-lua: fclose(): %s: %s\n", strerror(errno), out_path);
+		w.status = 1;
+	}
+
+	if (w.status != 0) {
+		unlink(out_path);
+	}
+
+	return w.status;
+}
+#endif
+
+static int main_build(int argc, char *argv[]) {
+	int status;
+	const char *root_dir;
+	const char *bin_dir;
+	const char *build_script;
+	const char *bootstrap_script;
+	lua_State *L;
+	int traceback_idx;
+
+	status = 1;
+
+	if (argc < 5) {
+		fputs("error: Oro build system called with insufficient arguments\n", stderr);
+		fputs("error: (hint: don't call `.oro/build` directly)\n", stderr);
+		status = 2;
+		goto exit;
+	}
+
+	root_dir = argv[1];
+	bin_dir = argv[2];
+	bootstrap_script = argv[3];
+	build_script = argv[4];
+
+	argv += 5;
+	argc -= 5;
+
+	L = luaL_newstate();
+
+	if (L == NULL) {
+		fputs("error: failed to initialize Lua state\n", stderr);
+		goto exit;
+	}
+
+	{
+		const char *profile = getenv("ORO_PROFILE");
+		if (profile != NULL && profile[0] != '\0' && strcmp(profile, "0") != 0) {
+			oro_profile.enabled = 1;
+			oro_profile.alloc = lua_getallocf(L, &oro_profile.alloc_ud);
+			lua_setallocf(L, &profile_alloc, &oro_profile);
+		}
+	}
+
+	luaL_openlibs(L);
+
+	lua_pushcfunction(L, &display_traceback);
+	traceback_idx = lua_gettop(L);
+
+	lua_newtable(L);
+	{
+		{
+			lua_pushstring(L, "root_dir");
+			lua_pushstring(L, root_dir);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "bin_dir");
+			lua_pushstring(L, bin_dir);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "build_script");
+			lua_pushstring(L, build_script);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "search_path");
+			lua_pushcfunction(L, search_path);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "execute");
+			lua_pushcfunction(L, execute_process);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "execute_many");
+			lua_pushcfunction(L, execute_many);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "write_ninja");
+			lua_pushcfunction(L, write_ninja);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "load_cached");
+			lua_pushcfunction(L, load_cached);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "hash_string");
+			lua_pushcfunction(L, hash_string);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "flat");
+			lua_pushcfunction(L, lua_flat);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "is_nuclear");
+			lua_pushcfunction(L, lua_is_nuclear);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "path_join");
+			lua_pushcfunction(L, lua_path_join);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "path_normalize");
+			lua_pushcfunction(L, lua_path_normalize);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "path_relpath");
+			lua_pushcfunction(L, lua_path_relpath);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "path_splitext");
+			lua_pushcfunction(L, lua_path_splitext);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "path_basename");
+			lua_pushcfunction(L, lua_path_basename);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "path_dirname");
+			lua_pushcfunction(L, lua_path_dirname);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "split");
+			lua_pushcfunction(L, split_string);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "cpu_count");
+			lua_pushinteger(L, cpu_count());
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "profiling");
+			lua_pushboolean(L, oro_profile.enabled);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "monotime");
+			lua_pushcfunction(L, lua_monotime);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "profile_stats");
+			lua_pushcfunction(L, lua_profile_stats);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushcfunction(L, &luaopen_lfs);
+			if (lua_pcall(L, 0, 0, traceback_idx) != 0) {
+				fprintf(stderr, "error: failed to load LFS: %s\n", lua_tostring(L, -1));
+				goto exit_close_state;
+			}
+
+			lua_pushliteral(L, "lfs");
+			lua_getglobal(L, "lfs");
+			lua_rawset(L, -3);
+			lua_pushnil(L);
+			lua_setglobal(L, "lfs");
+		}
+		{
+			lua_pushstring(L, "env");
+			pushenv(L);
+			lua_rawset(L, -3);
+		}
+		{
+			lua_pushstring(L, "arg");
+			lua_newtable(L);
+			for (int i = 0; i < argc; i++) {
+				lua_pushstring(L, argv[i]);
+				lua_rawseti(L, -2, i + 1);
+			}
+			lua_rawset(L, -3);
+		}
+	}
+	lua_setglobal(L, "__ORO__");
+
+	/*
+		Set up the package search path.
+		In the case we `require` a directory,
+		look for the "index" at `<dir>/_.lua`.
+	*/
+	lua_getglobal(L, "package");
+	lua_pushfstring(L, "%s/?.lua;%s/?/_.lua", root_dir, root_dir);
+	lua_setfield(L, -2, "path");
+
+#ifdef ORO_EMBEDDED_LUA
+	/*
+		Serve embedded modules right after `package.preload`,
+		ahead of the filesystem searchers.
+	*/
+	lua_getfield(L, -1, "searchers");
+	for (lua_Integer i = luaL_len(L, -1); i >= 2; i--) {
+		lua_geti(L, -1, i);
+		lua_seti(L, -2, i + 1);
+	}
+	lua_pushcfunction(L, &embedded_searcher);
+	lua_seti(L, -2, 2);
+	lua_pop(L, 1);
+#endif
+
+	lua_pop(L, 1);
+
+#ifdef ORO_EMBEDDED_LUA
+	const struct oro_embedded_lua_s *bootstrap = find_embedded_lua(ORO_EMBEDDED_BOOTSTRAP);
+	(void) bootstrap_script;
+
+	if (bootstrap == NULL) {
+		lua_pushliteral(L, "bootstrap script was not embedded");
+	}
+
+	if (bootstrap == NULL || load_embedded_lua(L, bootstrap) != 0) {
+#else
+	if (luaL_loadfile(L, bootstrap_script) != 0) {
+#endif
+		fprintf(stderr, "error: lua bootstrap failed: %s\n", lua_tostring(L, -1));
+		goto exit_close_state;
+	}
+
+	if (lua_pcall(L, 0, 0, traceback_idx) != 0) {
+		fprintf(stderr, "error: %s\n", lua_tostring(L, -1));
+		goto exit_close_state;
+	}
+
+	status = 0;
+
+exit_close_state:
+	lua_close(L);
+exit:
+	return status;
+}
+
+static int main_touch(int argc, char *argv[]) {
+	assert(argc > 0);
+
+	int status = 0;
+
+	for (int i = 1; i < argc; i++) {
+		const char *filepath = argv[i];
+
+		int fd = open(filepath, O_WRONLY | O_CREAT | O_APPEND, 0644);
+		if (fd == -1) {
+			fprintf(stderr, "touch: open(): %s: %s\n", strerror(errno), filepath);
+			status = 1;
+			continue;
+		}
+
+		if (futimens(fd, NULL)) {
+			fprintf(stderr, "touch: futimes(): %s: %s\n", strerror(errno), filepath);
+			status = 1;
+		}
+
+		if (close(fd) != 0) {
+			fprintf(stderr, "touch: warning: close(): %s: %s\n", strerror(errno), filepath);
+			// We don't count this as an error.
+		}
+	}
+
+	return status;
+}
+
+static int main_echo(int argc, char *argv[]) {
+	assert(argc > 0);
+
+	const char *sep = "";
+	for (int i = 1; i < argc; i++) {
+		printf("%s%s", sep, argv[i]);
+		sep = " ";
+	}
+	putc('\n', stdout);
+
+	return 0;
+}
+
+static int init_depfile(char *filepath) {
+	if (*filepath == 0) {
+		fputs("error: filepath cannot be empty\n", stderr);
+		return 2;
+	}
+
+	size_t len = strlen(filepath);
+	if (len < 3 || filepath[len-1] != 'd' || filepath[len-2] != '.') {
+		fprintf(stderr, "error: filepath must end with '.d': %s\n", filepath);
+		return 2;
+	}
+
+	int status = 1;
+
+	FILE *fd = fopen(filepath, "wb");
+
+	if (fd == NULL) {
+		fprintf(stderr, "error: fopen(): %s: %s\n", strerror(errno), filepath);
+		goto exit;
+	}
+
+	filepath[len - 2] = 0;
+
+	errno = 0;
+	if (fprintf(fd, "%s:\n", filepath) < 0) {
+		fprintf(stderr, "error: fprintf(): %s: %s\n", strerror(errno), filepath);
+		goto exit_close;
+	}
+
+	status = 0;
+
+exit_close:
+	filepath[len - 2] = '.';
+	fclose(fd);
+exit:
+	return status;
+}
+
+static int main_init_depfile(int argc, char *argv[]) {
+	assert(argc > 0);
+
+	if (argc == 1) {
+		fputs("error: no output file given\n", stderr);
+		return 2;
+	}
+
+	if (argc > 2) {
+		fprintf(stderr, "error: expected exactly 1 argument; got %d\n", argc - 1);
+		return 2;
+	}
+
+	return init_depfile(argv[1]);
+}
+
+static int main_with_depfile(int argc, char *argv[]) {
+	/*
+		with-depfile <depfile> -- <command...>
+
+		Initializes `depfile` (as with `init-depfile`) and then
+		replaces this process with `command`, which may overwrite
+		it. Guarantees the depfile exists (to appease Ninja) for
+		commands that don't always write one (e.g. compilers given
+		no "source" inputs) without needing a separate edge.
+	*/
+	assert(argc > 0);
+
+	if (argc < 4 || strcmp(argv[2], "--") != 0) {
+		fputs("error: usage: with-depfile <depfile> -- <command...>\n", stderr);
+		return 2;
+	}
+
+	int status = init_depfile(argv[1]);
+	if (status != 0) return status;
+
+	execvp(argv[3], &argv[3]);
+	fprintf(stderr, "with-depfile: execvp(): %s: %s\n", strerror(errno), argv[3]);
+	return 127;
+}
+
+static int main_unity(int argc, char *argv[]) {
+	/*
+		unity <out> <sources...>
+
+		Writes a unity ("jumbo") translation unit to `out` that
+		`#include`s each of `sources` (paths relative to the working
+		directory, as Ninja passes them) in order. `out` is left
+		untouched if it wouldn't change (for use with `restat`).
+	*/
+	assert(argc > 0);
+
+	if (argc < 3) {
+		fputs("error: usage: unity <out> <sources...>\n", stderr);
+		return 2;
+	}
+
+	const char *out = argv[1];
+
+	/* relative includes are resolved from the including file's directory */
+	size_t depth = 0;
+	for (const char *c = out; *c; c++) {
+		if (*c == '/' && c[1] != 0 && c[1] != '/') ++depth;
+	}
+
+	if (out[0] == '/') depth = 0;
+
+	size_t cap = 256, len = 0;
+	char *data = malloc(cap);
+	if (data == NULL) abort(); /* TODO better error message */
+
+	static const char header[] = "/* generated by `oro-build --syscall unity`; do not edit */\n";
+	memcpy(data, header, sizeof(header) - 1);
+	len = sizeof(header) - 1;
+
+	for (int i = 2; i < argc; i++) {
+		const char *source = argv[i];
+		int absolute = source[0] == '/';
+		size_t need = len + strlen(source) + 3 * depth + sizeof("#include \"\"\n");
+
+		if (strchr(source, '"') != NULL || strchr(source, '\n') != NULL) {
+			fprintf(stderr, "error: unity: unsupported source path: %s\n", source);
+			free(data);
+			return 2;
+		}
+
+		if (need > cap) {
+			while (need > cap) cap *= 2;
+			data = realloc(data, cap);
+			if (data == NULL) abort(); /* TODO better error message */
+		}
+
+		len += (size_t) sprintf(&data[len], "#include \"");
+		for (size_t d = 0; !absolute && d < depth; d++) {
+			memcpy(&data[len], "../", 3);
+			len += 3;
+		}
+		len += (size_t) sprintf(&data[len], "%s\"\n", source);
+	}
+
+	int status = 0;
+	if (write_if_changed(out, data, len) < 0) {
+		fprintf(stderr, "error: unity: %s: %s\n", strerror(errno), out);
+		status = 1;
+	}
+
+	free(data);
+	return status;
+}
+
+struct cxx_buf {
+	char *data;
+	size_t len;
+	size_t cap;
+};
+
+static void cxx_buf_cat_n(struct cxx_buf *b, const char *s, size_t n) {
+	if (b->len + n + 1 > b->cap) {
+		size_t cap = b->cap ? b->cap : 256;
+		while (b->len + n + 1 > cap) cap *= 2;
+		b->data = realloc(b->data, cap);
+		if (b->data == NULL) abort(); /* TODO better error message */
+		b->cap = cap;
+	}
+
+	memcpy(&b->data[b->len], s, n);
+	b->len += n;
+	b->data[b->len] = 0;
+}
+
+static void cxx_buf_cat(struct cxx_buf *b, const char *s) {
+	cxx_buf_cat_n(b, s, strlen(s));
+}
+
+static void cxx_buf_cat_ninja_path(struct cxx_buf *b, const char *s) {
+	/* escapes a path for a Ninja build line */
+	for (; *s; s++) {
+		if (*s == '$' || *s == ' ' || *s == ':' || *s == '\n') cxx_buf_cat_n(b, "$", 1);
+		cxx_buf_cat_n(b, s, 1);
+	}
+}
+
+struct json_s {
+	const char *p;
+	const char *end;
+};
+
+static void json_ws(struct json_s *j) {
+	while (j->p < j->end && (*j->p == ' ' || *j->p == '\t' || *j->p == '\n' || *j->p == '\r')) ++j->p;
+}
+
+static int json_peek(struct json_s *j, char c) {
+	json_ws(j);
+	return j->p < j->end && *j->p == c;
+}
+
+static int json_expect(struct json_s *j, char c) {
+	if (!json_peek(j, c)) return -1;
+	++j->p;
+	return 0;
+}
+
+static char * json_string(struct json_s *j) {
+	/* returns a malloc'd copy of the (unescaped) string, or NULL */
+	if (json_expect(j, '"') != 0) return NULL;
+
+	struct cxx_buf b = { NULL, 0, 0 };
+	cxx_buf_cat_n(&b, "", 0);
+
+	while (j->p < j->end && *j->p != '"') {
+		char c = *j->p++;
+
+		if (c == '\\') {
+			if (j->p >= j->end) goto err;
+			c = *j->p++;
+
+			switch (c) {
+			case '"': case '\\': case '/': break;
+			case 'b': c = '\b'; break;
+			case 'f': c = '\f'; break;
+			case 'n': c = '\n'; break;
+			case 'r': c = '\r'; break;
+			case 't': c = '\t'; break;
+			case 'u': {
+				/* (surrogate pairs aren't combined) */
+				unsigned cp = 0;
+				for (int i = 0; i < 4; i++) {
+					if (j->p >= j->end) goto err;
+					char h = *j->p++;
+					cp <<= 4;
+					if (h >= '0' && h <= '9') cp |= (unsigned) (h - '0');
+					else if (h >= 'a' && h <= 'f') cp |= (unsigned) (h - 'a' + 10);
+					else if (h >= 'A' && h <= 'F') cp |= (unsigned) (h - 'A' + 10);
+					else goto err;
+				}
+
+				char utf8[3];
+				size_t n;
+				if (cp < 0x80) {
+					utf8[0] = (char) cp;
+					n = 1;
+				} else if (cp < 0x800) {
+					utf8[0] = (char) (0xC0 | (cp >> 6));
+					utf8[1] = (char) (0x80 | (cp & 0x3F));
+					n = 2;
+				} else {
+					utf8[0] = (char) (0xE0 | (cp >> 12));
+					utf8[1] = (char) (0x80 | ((cp >> 6) & 0x3F));
+					utf8[2] = (char) (0x80 | (cp & 0x3F));
+					n = 3;
+				}
+
+				cxx_buf_cat_n(&b, utf8, n);
+				continue;
+			}
+			default:
+				goto err;
+			}
+		}
+
+		cxx_buf_cat_n(&b, &c, 1);
+	}
+
+	if (j->p >= j->end) goto err;
+	++j->p;
+	return b.data;
+
+err:
+	free(b.data);
+	return NULL;
+}
+
+static int json_skip(struct json_s *j, int depth) {
+	/* skips any value */
+	json_ws(j);
+	if (depth > 64 || j->p >= j->end) return -1;
+
+	char c = *j->p;
+
+	if (c == '"') {
+		char *s = json_string(j);
+		if (s == NULL) return -1;
+		free(s);
+		return 0;
+	}
+
+	if (c == '{' || c == '[') {
+		char close = c == '{' ? '}' : ']';
+		++j->p;
+
+		if (json_peek(j, close)) {
+			++j->p;
+			return 0;
+		}
+
+		for (;;) {
+			if (c == '{') {
+				char *key = json_string(j);
+				if (key == NULL) return -1;
+				free(key);
+				if (json_expect(j, ':') != 0) return -1;
+			}
+
+			if (json_skip(j, depth + 1) != 0) return -1;
+
+			if (json_peek(j, ',')) {
+				++j->p;
+				continue;
+			}
+
+			return json_expect(j, close);
+		}
+	}
+
+	/* numbers, `true`, `false` and `null` */
+	const char *start = j->p;
+	while (
+		j->p < j->end
+		&& ((*j->p >= '0' && *j->p <= '9') || (*j->p >= 'a' && *j->p <= 'z')
+			|| *j->p == '-' || *j->p == '+' || *j->p == '.' || *j->p == 'E')
+	) {
+		++j->p;
+	}
+
+	return j->p == start ? -1 : 0;
+}
+
+static int json_object_next(struct json_s *j, int *first, char **key) {
+	/*
+		Advances to an object's next member, returning 1 (with the
+		malloc'd `key` set, before its value), 0 at the end, or -1.
+	*/
+	if (*first) {
+		*first = 0;
+		if (json_expect(j, '{') != 0) return -1;
+		if (json_peek(j, '}')) {
+			++j->p;
+			return 0;
+		}
+	} else if (json_peek(j, ',')) {
+		++j->p;
+	} else {
+		return json_expect(j, '}') == 0 ? 0 : -1;
+	}
+
+	*key = json_string(j);
+	if (*key == NULL) return -1;
+
+	if (json_expect(j, ':') != 0) {
+		free(*key);
+		return -1;
+	}
+
+	return 1;
+}
+
+static int json_array_next(struct json_s *j, int *first) {
+	/* like `json_object_next`, for arrays */
+	if (*first) {
+		*first = 0;
+		if (json_expect(j, '[') != 0) return -1;
+		if (json_peek(j, ']')) {
+			++j->p;
+			return 0;
+		}
+		return 1;
+	}
+
+	if (json_peek(j, ',')) {
+		++j->p;
+		return 1;
+	}
+
+	return json_expect(j, ']') == 0 ? 0 : -1;
+}
+
+struct cxx_names {
+	char **names;
+	size_t count;
+	size_t cap;
+};
+
+static void cxx_names_push(struct cxx_names *l, char *name) {
+	if (l->count == l->cap) {
+		l->cap = l->cap ? l->cap * 2 : 4;
+		l->names = realloc(l->names, sizeof(*l->names) * l->cap);
+		if (l->names == NULL) abort(); /* TODO better error message */
+	}
+
+	l->names[l->count++] = name;
+}
+
+static void cxx_names_free(struct cxx_names *l) {
+	for (size_t i = 0; i < l->count; i++) free(l->names[i]);
+	free(l->names);
+}
+
+struct cxx_unit {
+	const char *object; /* NULL if imported from another target */
+	const char *bmidir;
+	const char *ddi;
+	struct cxx_names provides;
+	struct cxx_names requires;
+	int visited;
+};
+
+static int p1689_names(struct json_s *j, struct cxx_names *names) {
+	/* collects the `logical-name`s of a `provides` or `requires` array */
+	int first = 1;
+	int r;
+
+	while ((r = json_array_next(j, &first)) == 1) {
+		int member_first = 1;
+		int m;
+		char *key;
+
+		while ((m = json_object_next(j, &member_first, &key)) == 1) {
+			if (strcmp(key, "logical-name") == 0) {
+				char *name = json_string(j);
+				if (name == NULL) {
+					free(key);
+					return -1;
+				}
+				cxx_names_push(names, name);
+			} else if (json_skip(j, 0) != 0) {
+				free(key);
+				return -1;
+			}
+
+			free(key);
+		}
+
+		if (m < 0) return -1;
+	}
+
+	return r;
+}
+
+static int p1689_parse(const char *data, size_t len, struct cxx_unit *unit) {
+	/* reads a P1689 scan (`{"rules": [{"provides": [...], "requires": [...]}]}`) */
+	struct json_s j = { data, data + len };
+	int first = 1;
+	int r;
+	char *key;
+
+	while ((r = json_object_next(&j, &first, &key)) == 1) {
+		int ok = 0;
+
+		if (strcmp(key, "rules") == 0) {
+			int rules_first = 1;
+			int rr;
+
+			while ((rr = json_array_next(&j, &rules_first)) == 1) {
+				int rule_first = 1;
+				int m;
+				char *rule_key;
+
+				while ((m = json_object_next(&j, &rule_first, &rule_key)) == 1) {
+					int rm;
+					if (strcmp(rule_key, "provides") == 0) {
+						rm = p1689_names(&j, &unit->provides);
+					} else if (strcmp(rule_key, "requires") == 0) {
+						rm = p1689_names(&j, &unit->requires);
+					} else {
+						rm = json_skip(&j, 0);
+					}
+
+					free(rule_key);
+					if (rm < 0) {
+						m = -1;
+						break;
+					}
+				}
+
+				if (m < 0) {
+					rr = -1;
+					break;
+				}
+			}
+
+			ok = rr;
+		} else {
+			ok = json_skip(&j, 0);
+		}
+
+		free(key);
+		if (ok < 0) return -1;
+	}
+
+	return r;
+}
+
+static struct cxx_unit * cxx_provider(struct cxx_unit *units, size_t nunits, const char *name) {
+	for (size_t i = 0; i < nunits; i++) {
+		for (size_t k = 0; k < units[i].provides.count; k++) {
+			if (strcmp(units[i].provides.names[k], name) == 0) return &units[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void cxx_bmi_path(struct cxx_buf *b, const char *bmidir, const char *name, const char *ext) {
+	/* partitions (`mod:part`) can't be file names everywhere */
+	cxx_buf_cat(b, bmidir);
+	cxx_buf_cat_n(b, "/", 1);
+	for (const char *c = name; *c; c++) {
+		cxx_buf_cat_n(b, (*c == ':' || *c == '/' || *c == '\\') ? "-" : c, 1);
+	}
+	cxx_buf_cat(b, ext);
+}
+
+static int cxx_collect(struct cxx_unit *units, size_t nunits, struct cxx_unit *unit, struct cxx_names *out) {
+	/* collects the (transitive) imports of `unit` into `out` (borrowed names) */
+	for (size_t i = 0; i < unit->requires.count; i++) {
+		const char *name = unit->requires.names[i];
+		struct cxx_unit *provider = cxx_provider(units, nunits, name);
+
+		/* left to the compiler (e.g. `import std;`) */
+		if (provider == NULL) continue;
+
+		if (provider->visited) continue;
+		provider->visited = 1;
+
+		cxx_names_push(out, (char *) name);
+		if (cxx_collect(units, nunits, provider, out) != 0) return -1;
+	}
+
+	return 0;
+}
+
+static int main_cxx_modules_collate(int argc, char *argv[]) {
+	/*
+		cxx-modules-collate <dyndep> <bmidir> <bmiext> <gcc|clang> -- <object> <scan> [<object> <scan>...] [-- <bmidir> <scan>...]
+
+		Collates the P1689 dependency scans of a target's C++
+		sources (one `scan` per `object`) into a Ninja dyndep file,
+		which declares each object's compiled module interface
+		(BMI; `<bmidir>/<module><bmiext>`) as an extra output of its
+		compilation and the BMIs it imports as extra inputs.
+
+		Modules of other targets can be imported, too; the scans
+		after the second `--` are theirs, along with the directory
+		each one's BMIs are in. Imports that no scan provides are
+		left to the compiler (e.g. `import std;`).
+
+		Each object also gets a module map (`<object>.modmap`)
+		telling the compiler where the BMIs are, either as a GCC
+		`-fmodule-mapper` file or as Clang flags (for use as an `@`
+		response file).
+
+		Outputs are left untouched if they wouldn't change (for use
+		with `restat`).
+	*/
+	assert(argc > 0);
+
+	int split = 6;
+	while (split < argc && strcmp(argv[split], "--") != 0) split++;
+
+	if (
+		argc < 8
+		|| strcmp(argv[5], "--") != 0
+		|| split == 6
+		|| (split - 6) % 2 != 0
+		|| (split < argc && (argc - split - 1) % 2 != 0)
+	) {
+		fputs("error: usage: cxx-modules-collate <dyndep> <bmidir> <bmiext> <gcc|clang> -- <object> <scan> [<object> <scan>...] [-- <bmidir> <scan>...]\n", stderr);
+		return 2;
+	}
+
+	const char *dyndep = argv[1];
+	const char *bmidir = argv[2];
+	const char *bmiext = argv[3];
+	int clang = strcmp(argv[4], "clang") == 0;
+
+	if (!clang && strcmp(argv[4], "gcc") != 0) {
+		fprintf(stderr, "error: cxx-modules-collate: unknown module map format: %s\n", argv[4]);
+		return 2;
+	}
+
+	/* the target's own units come first */
+	size_t nlocal = (size_t) (split - 6) / 2;
+	size_t nunits = nlocal + (split < argc ? (size_t) (argc - split - 1) / 2 : 0);
+	struct cxx_unit *units = calloc(nunits, sizeof(*units));
+	if (units == NULL) abort(); /* TODO better error message */
+
+	int status = 0;
+
+	for (size_t i = 0; i < nunits; i++) {
+		if (i < nlocal) {
+			units[i].object = argv[6 + i * 2];
+			units[i].bmidir = bmidir;
+			units[i].ddi = argv[7 + i * 2];
+		} else {
+			units[i].bmidir = argv[split + 1 + (i - nlocal) * 2];
+			units[i].ddi = argv[split + 2 + (i - nlocal) * 2];
+		}
+
+		size_t len;
+		char *data = read_whole_file(units[i].ddi, &len);
+		if (data == NULL) {
+			fprintf(stderr, "error: cxx-modules-collate: %s: %s\n", strerror(errno), units[i].ddi);
+			status = 1;
+			goto done;
+		}
+
+		int r = p1689_parse(data, len, &units[i]);
+		free(data);
+
+		if (r < 0) {
+			fprintf(stderr, "error: cxx-modules-collate: %s: malformed P1689 scan\n", units[i].ddi);
+			status = 1;
+			goto done;
+		}
+	}
+
+	/* each module must come from exactly one source */
+	for (size_t i = 0; i < nunits; i++) {
+		for (size_t k = 0; k < units[i].provides.count; k++) {
+			struct cxx_unit *provider = cxx_provider(units, nunits, units[i].provides.names[k]);
+			if (provider != &units[i]) {
+				fprintf(
+					stderr,
+					"error: cxx-modules-collate: module %s is provided by both %s and %s\n",
+					units[i].provides.names[k],
+					provider->ddi,
+					units[i].ddi
+				);
+				status = 1;
+				goto done;
+			}
+		}
+	}
+
+	struct cxx_buf dd = { NULL, 0, 0 };
+	cxx_buf_cat(&dd, "ninja_dyndep_version = 1\n");
+
+	for (size_t i = 0; i < nlocal && status == 0; i++) {
+		struct cxx_unit *unit = &units[i];
+		struct cxx_names imports = { NULL, 0, 0 };
+
+		for (size_t u = 0; u < nunits; u++) units[u].visited = 0;
+		unit->visited = 1;
+
+		if (cxx_collect(units, nunits, unit, &imports) != 0) {
+			free(imports.names);
+			status = 1;
+			break;
+		}
+
+		struct cxx_buf modmap = { NULL, 0, 0 };
+		struct cxx_buf bmi = { NULL, 0, 0 };
+
+		if (!clang) cxx_buf_cat(&modmap, "$root .\n");
+		else cxx_buf_cat_n(&modmap, "", 0);
+
+		cxx_buf_cat(&dd, "\nbuild ");
+		cxx_buf_cat_ninja_path(&dd, unit->object);
+
+		for (size_t k = 0; k < unit->provides.count; k++) {
+			const char *name = unit->provides.names[k];
+
+			bmi.len = 0;
+			cxx_bmi_path(&bmi, bmidir, name, bmiext);
+
+			cxx_buf_cat(&dd, k == 0 ? " | " : " ");
+			cxx_buf_cat_ninja_path(&dd, bmi.data);
+
+			if (clang) {
+				cxx_buf_cat(&modmap, "-x c++-module\n-fmodule-output=");
+				cxx_buf_cat(&modmap, bmi.data);
+				cxx_buf_cat(&modmap, "\n");
+			} else {
+				cxx_buf_cat(&modmap, name);
+				cxx_buf_cat(&modmap, " ");
+				cxx_buf_cat(&modmap, bmi.data);
+				cxx_buf_cat(&modmap, "\n");
+			}
+		}
+
+		cxx_buf_cat(&dd, ": dyndep");
+
+		for (size_t k = 0; k < imports.count; k++) {
+			const char *name = imports.names[k];
+
+			bmi.len = 0;
+			cxx_bmi_path(&bmi, cxx_provider(units, nunits, name)->bmidir, name, bmiext);
+
+			cxx_buf_cat(&dd, k == 0 ? " | " : " ");
+			cxx_buf_cat_ninja_path(&dd, bmi.data);
+
+			if (clang) {
+				cxx_buf_cat(&modmap, "-fmodule-file=");
+				cxx_buf_cat(&modmap, name);
+				cxx_buf_cat(&modmap, "=");
+			} else {
+				cxx_buf_cat(&modmap, name);
+				cxx_buf_cat(&modmap, " ");
+			}
+
+			cxx_buf_cat(&modmap, bmi.data);
+			cxx_buf_cat(&modmap, "\n");
+		}
+
+		cxx_buf_cat(&dd, "\n  restat = 1\n");
+
+		struct cxx_buf modmap_path = { NULL, 0, 0 };
+		cxx_buf_cat(&modmap_path, unit->object);
+		cxx_buf_cat(&modmap_path, ".modmap");
+
+		if (write_if_changed(modmap_path.data, modmap.data, modmap.len) < 0) {
+			fprintf(stderr, "error: cxx-modules-collate: %s: %s\n", strerror(errno), modmap_path.data);
+			status = 1;
+		}
+
+		free(modmap_path.data);
+		free(modmap.data);
+		free(bmi.data);
+		free(imports.names);
+	}
+
+	if (status == 0 && write_if_changed(dyndep, dd.data, dd.len) < 0) {
+		fprintf(stderr, "error: cxx-modules-collate: %s: %s\n", strerror(errno), dyndep);
+		status = 1;
+	}
+
+	free(dd.data);
+
+done:
+	for (size_t i = 0; i < nunits; i++) {
+		cxx_names_free(&units[i].provides);
+		cxx_names_free(&units[i].requires);
+	}
+
+	free(units);
+	return status;
+}
+
+static int cp_fd_readwrite(int infd, int outfd, off_t offset, off_t size, const char *from) {
+	char buf[64 * 1024];
+
+	while (offset < size) {
+		ssize_t r = pread(infd, buf, sizeof(buf), offset);
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "pread(): %s: %s\n", strerror(errno), from);
+			return 1;
+		}
+
+		if (r == 0) break; /* truncated while copying */
+
+		for (ssize_t written = 0; written < r;) {
+			ssize_t w = pwrite(outfd, &buf[written], (size_t) (r - written), offset + written);
+			if (w < 0) {
+				if (errno == EINTR) continue;
+				fprintf(stderr, "pwrite(): %s: %s\n", strerror(errno), from);
+				return 1;
+			}
+
+			written += w;
+		}
+
+		offset += r;
+	}
+
+	return 0;
+}
+
+static int cp_fallback_errno(int err) {
+	/* Errors that mean "this method isn't supported here; try the next one" */
+	return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP || err == ENOTSUP || err == ENOTTY || err == EBADF || err == EPERM;
+}
+
+static int cp_fd(const char *from, int infd, const struct stat *stats, int outfd) {
+	/*
+		Copies `infd` into the (empty) `outfd`, preferring, in order:
+		a reflink (FICLONE; copy-on-write filesystems such as btrfs
+		and XFS), `copy_file_range`, `sendfile`, and finally a plain
+		read/write loop. Each method picks up where the last left off.
+	*/
+	off_t size = stats->st_size;
+	off_t offset = 0;
+
+	if (size == 0) return 0;
+
+#ifdef __linux__
+	if (ioctl(outfd, FICLONE, infd) == 0) return 0;
+
+#	ifdef __NR_copy_file_range
+	while (offset < size) {
+		loff_t off_in = offset;
+		loff_t off_out = offset;
+		long r = syscall(__NR_copy_file_range, infd, &off_in, outfd, &off_out, (size_t) (size - offset), 0u);
+
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			if (cp_fallback_errno(errno)) break;
+			fprintf(stderr, "copy_file_range(): %s: %s\n", strerror(errno), from);
+			return 1;
+		}
+
+		if (r == 0) break;
+		offset += (off_t) r;
+	}
+
+	if (offset >= size) return 0;
+#	endif
+
+	while (offset < size) {
+		off_t off_in = offset;
+		ssize_t sent = sendfile(outfd, infd, &off_in, (size_t) (size - offset));
+
+		if (sent < 0) {
+			if (errno == EINTR) continue;
+			if (cp_fallback_errno(errno)) break;
+			fprintf(stderr, "sendfile(): %s: %s\n", strerror(errno), from);
+			return 1;
+		}
+
+		if (sent == 0) break;
+		offset += (off_t) sent;
+	}
+
+	if (offset >= size) return 0;
+#endif
+
+	return cp_fd_readwrite(infd, outfd, offset, size, from);
+}
+
+static int cp_same_contents(int fda, int fdb, off_t size) {
+	/*
+		Returns 1 if both (same-sized) files have identical
+		contents, 0 otherwise (including when they can't be
+		mapped, in which case the caller just copies).
+	*/
+	if (size == 0) return 1;
+
+	void *a = mmap(NULL, (size_t) size, PROT_READ, MAP_PRIVATE, fda, 0);
+	if (a == MAP_FAILED) return 0;
+
+	void *b = mmap(NULL, (size_t) size, PROT_READ, MAP_PRIVATE, fdb, 0);
+	if (b == MAP_FAILED) {
+		munmap(a, (size_t) size);
+		return 0;
+	}
+
+	int same = memcmp(a, b, (size_t) size) == 0;
+
+	munmap(b, (size_t) size);
+	munmap(a, (size_t) size);
+
+	return same;
+}
+
+static int cp_file_at(int outdir, const char *dirpath, const char *to, const char *from) {
+	/*
+		Copies `from` to `to` (relative to `outdir`) and applies
+		the source's mode and timestamps. If `to` already has
+		the same contents, it's left untouched so that Ninja
+		(with `restat`) can prune downstream work.
+
+		Outputs are always owner-writable, so that read-only
+		sources (e.g. from a Nix store or a sysroot) can be
+		copied over again when they change.
+	*/
+#	define CP_OUTPATH dirpath ? dirpath : "", dirpath ? "/" : "", to
+
+	int status = 1;
+
+	int infd = open(from, O_RDONLY);
+	if (infd == -1) {
+		fprintf(stderr, "open(O_RDONLY): %s: %s\n", strerror(errno), from);
+		goto exit;
+	}
+
+	struct stat stats;
+	if (fstat(infd, &stats) != 0) {
+		fprintf(stderr, "fstat(): %s: %s\n", strerror(errno), from);
+		goto exit_close_inf;
+	}
+
+	mode_t mode = (stats.st_mode & 07777) | S_IWUSR;
+
+	int existingfd = openat(outdir, to, O_RDONLY);
+	if (existingfd != -1) {
+		struct stat existing;
+		int same = fstat(existingfd, &existing) == 0
+			&& S_ISREG(existing.st_mode)
+			&& existing.st_size == stats.st_size
+			&& cp_same_contents(infd, existingfd, stats.st_size);
+
+		if (same && (existing.st_mode & 07777) != mode) {
+			/* Doesn't affect the mtime */
+			if (fchmod(existingfd, mode) != 0) {
+				fprintf(stderr, "fchmod(): %s: %s%s%s\n", strerror(errno), CP_OUTPATH);
+				same = 0;
+			}
+		}
+
+		close(existingfd);
+
+		if (same) {
+			status = 0;
+			goto exit_close_inf;
+		}
+	}
+
+	int outfd = openat(outdir, to, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (outfd == -1 && errno == EACCES && unlinkat(outdir, to, 0) == 0) {
+		/* (a read-only output left by an older harness) */
+		outfd = openat(outdir, to, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	}
+	if (outfd == -1) {
+		fprintf(stderr, "open(O_WRONLY): %s: %s%s%s\n", strerror(errno), CP_OUTPATH);
+		goto exit_close_inf;
+	}
+
+	if (cp_fd(from, infd, &stats, outfd) != 0) {
+		goto exit_close_outf;
+	}
+
+	if (fchmod(outfd, mode) != 0) {
+		fprintf(stderr, "fchmod(): %s: %s%s%s\n", strerror(errno), CP_OUTPATH);
+		goto exit_close_outf;
+	}
+
+	struct timespec times[2] = { stats.st_atim, stats.st_mtim };
+	if (futimens(outfd, times) != 0) {
+		fprintf(stderr, "futimens(): %s: %s%s%s\n", strerror(errno), CP_OUTPATH);
+		goto exit_close_outf;
+	}
+
+	status = 0;
+
+exit_close_outf:
+	if (close(outfd) != 0) {
+		fprintf(stderr, "close(): %s: %s%s%s\n", strerror(errno), CP_OUTPATH);
+		status = 1;
+	}
+exit_close_inf:
+	close(infd);
+exit:
+	return status;
+
+#	undef CP_OUTPATH
+}
+
+static int cp_file(const char *from, const char *to) {
+#ifdef _WIN32
+	// PR welcome!
+#	error "`--syscall cp` is unsupported on Windows"
+#else
+	return cp_file_at(AT_FDCWD, NULL, to, from);
+#endif
+}
+
+static int cp_file_into(int outdir, const char *dirpath, const char *filename) {
+	const char *base = strrchr(filename, '/');
+	base = base ? &base[1] : filename;
+	return cp_file_at(outdir, dirpath, base, filename);
+}
+
+static int cp_wait_one(void) {
+	/* Returns non-zero if the reaped child failed */
+	int wstatus;
+	pid_t pid;
+
+	while ((pid = wait(&wstatus)) == -1 && errno == EINTR);
+
+	if (pid == -1) {
+		fprintf(stderr, "wait(): %s\n", strerror(errno));
+		return 1;
+	}
+
+	return !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0;
+}
+
+static int main_cp(int argc, char *argv[]) {
+	assert(argc > 0);
+
+	if (argc < 3) {
+		fputs("error: usage: cp <inputs[...]> <output[_directory]>\n", stderr);
+		return 2;
+	}
+
+	int failed = 0;
+
+	if (argc == 3) {
+		failed = cp_file(argv[1], argv[2]) != 0;
+	} else {
+		assert(argc > 3);
+
+		const char *dirpath = argv[argc - 1];
+		int outdir = open(dirpath, O_DIRECTORY | O_PATH);
+
+		if (outdir == -1) {
+			fprintf(stderr, "open(DIRECTORY): %s: %s\n", strerror(errno), dirpath);
+			failed = 1;
+		} else {
+			/*
+				Copy the files concurrently (one child process
+				per file, up to the number of CPUs at a time).
+			*/
+			int max_running = cpu_count();
+			int running = 0;
+
+			for (int i = 1, last = argc - 1; i < last; i++) {
+				if (running == max_running) {
+					failed |= cp_wait_one();
+					--running;
+				}
+
+				pid_t pid = fork();
+
+				if (pid == -1) {
+					/* Just do it ourselves */
+					failed |= cp_file_into(outdir, dirpath, argv[i]) != 0;
+				} else if (pid == 0) {
+					_exit(cp_file_into(outdir, dirpath, argv[i]) != 0);
+				} else {
+					++running;
+				}
+			}
+
+			while (running > 0) {
+				failed |= cp_wait_one();
+				--running;
+			}
+
+			close(outdir);
+		}
+	}
+
+	return failed;
+}
+
+#define ORO_WIC_SUFFIX ".oro-prev"
+
+static int main_write_if_changed(int argc, char *argv[]) {
+	/*
+		write-if-changed <outputs...> -- <command...>
+
+		Runs `command`, but keeps any output whose contents
+		didn't change exactly as it was (same inode, same mtime)
+		so that Ninja's `restat` can prune downstream work.
+
+		Existing outputs are moved aside before the command runs;
+		afterwards, each one whose new contents are identical is
+		moved back over the new file. If the command fails, all
+		of the previous outputs are restored.
+	*/
+	assert(argc > 0);
+
+	int sep = -1;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--") == 0) {
+			sep = i;
+			break;
+		}
+	}
+
+	if (sep == -1 || sep == argc - 1) {
+		fputs("error: usage: write-if-changed <outputs...> -- <command...>\n", stderr);
+		return 2;
+	}
+
+	int noutputs = sep - 1;
+	char **outputs = &argv[1];
+	char **prev = calloc((size_t) (noutputs > 0 ? noutputs : 1), sizeof(*prev));
+	if (prev == NULL) abort(); /* TODO better error message */
+
+	int status = 1;
+
+	for (int i = 0; i < noutputs; i++) {
+		size_t len = strlen(outputs[i]);
+		char *aside = malloc(len + sizeof(ORO_WIC_SUFFIX));
+		if (aside == NULL) abort(); /* TODO better error message */
+		memcpy(aside, outputs[i], len);
+		memcpy(&aside[len], ORO_WIC_SUFFIX, sizeof(ORO_WIC_SUFFIX));
+
+		if (rename(outputs[i], aside) == 0) {
+			prev[i] = aside;
+		} else {
+			if (errno != ENOENT) {
+				fprintf(stderr, "write-if-changed: rename(): %s: %s\n", strerror(errno), outputs[i]);
+			}
+
+			free(aside);
+		}
+	}
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		fprintf(stderr, "write-if-changed: fork(): %s\n", strerror(errno));
+		goto restore;
+	}
+
+	if (pid == 0) {
+		execvp(argv[sep + 1], &argv[sep + 1]);
+		fprintf(stderr, "write-if-changed: execvp(): %s: %s\n", strerror(errno), argv[sep + 1]);
+		_exit(127);
+	}
+
+	int wstatus;
+	while (waitpid(pid, &wstatus, 0) == -1) {
+		if (errno != EINTR) {
+			fprintf(stderr, "write-if-changed: waitpid(): %s\n", strerror(errno));
+			goto restore;
+		}
+	}
+
+	if (WIFEXITED(wstatus)) {
+		status = WEXITSTATUS(wstatus);
+	} else {
+		status = 128 + (WIFSIGNALED(wstatus) ? WTERMSIG(wstatus) : 0);
+	}
+
+	if (status != 0) goto restore;
+
+	for (int i = 0; i < noutputs; i++) {
+		if (prev[i] == NULL) continue;
+
+		int same = 0;
+		int newfd = open(outputs[i], O_RDONLY);
+		int oldfd = open(prev[i], O_RDONLY);
+
+		if (newfd != -1 && oldfd != -1) {
+			struct stat newstats, oldstats;
+			same = fstat(newfd, &newstats) == 0
+				&& fstat(oldfd, &oldstats) == 0
+				&& S_ISREG(newstats.st_mode)
+				&& newstats.st_size == oldstats.st_size
+				&& cp_same_contents(newfd, oldfd, newstats.st_size);
+		}
+
+		if (newfd != -1) close(newfd);
+		if (oldfd != -1) close(oldfd);
+
+		if (same) {
+			if (rename(prev[i], outputs[i]) != 0) {
+				fprintf(stderr, "write-if-changed: rename(): %s: %s\n", strerror(errno), prev[i]);
+				unlink(prev[i]);
+			}
+		} else {
+			unlink(prev[i]);
+		}
+	}
+
+	goto exit;
+
+restore:
+	if (status == 0) status = 1;
+
+	for (int i = 0; i < noutputs; i++) {
+		if (prev[i] != NULL && rename(prev[i], outputs[i]) != 0) {
+			fprintf(stderr, "write-if-changed: rename(): %s: %s\n", strerror(errno), prev[i]);
+		}
+	}
+
+exit:
+	for (int i = 0; i < noutputs; i++) free(prev[i]);
+	free(prev);
+	return status;
+}
+
+#define ORO_CC_CACHE_VERSION "oro-cc-cache-2"
+#define ORO_CC_CACHE_SUBDIRS 256
+#define ORO_CC_CACHE_PATH_MAX 4096
+
+struct cc_cache_hash {
+	uint64_t a;
+	uint64_t b;
+};
+
+static void cc_cache_update(struct cc_cache_hash *hash, const void *data, size_t len) {
+	/* two FNV-1a lanes with different offset bases (128 bits of key) */
+	hash->a = fnv1a64(data, len, hash->a);
+	hash->b = fnv1a64(data, len, hash->b);
+}
+
+static void cc_cache_update_str(struct cc_cache_hash *hash, const char *str) {
+	cc_cache_update(hash, str, strlen(str) + 1);
+}
+
+static int cc_cache_update_identity(struct cc_cache_hash *hash, const char *path, const char *suffix) {
+	/* hashes a file's size and mtime (in place of its contents) */
+	char fullpath[ORO_CC_CACHE_PATH_MAX];
+	if (snprintf(fullpath, sizeof(fullpath), "%s%s", path, suffix) >= (int) sizeof(fullpath)) return -1;
+
+	struct stat stats;
+	if (stat(fullpath, &stats) != 0) return -1;
+
+	uint64_t identity[3] = {
+		(uint64_t) stats.st_size,
+		(uint64_t) stats.st_mtim.tv_sec,
+		(uint64_t) stats.st_mtim.tv_nsec
+	};
+
+	cc_cache_update(hash, identity, sizeof(identity));
+	return 0;
+}
+
+#define ORO_CC_CACHE_KEY_SUFFIX ".ccid"
+
+static int cc_cache_update_pch(struct cc_cache_hash *hash, const char *path, const char *suffix) {
+	/*
+		Hashes a precompiled header, which (with `-fpch-preprocess`
+		or `-include-pch`) stands in for its source in the
+		preprocessed output. Its mtime changes with every clean
+		build and GCC's aren't reproducible byte-for-byte, so
+		the PCH's own cache key (see `cc_cache_write_key()`)
+		is used when it has one; otherwise, its contents.
+	*/
+	char fullpath[ORO_CC_CACHE_PATH_MAX];
+	if (snprintf(fullpath, sizeof(fullpath), "%s%s" ORO_CC_CACHE_KEY_SUFFIX, path, suffix) >= (int) sizeof(fullpath)) return -1;
+
+	size_t len;
+	char *key = read_whole_file(fullpath, &len);
+	if (key != NULL) {
+		cc_cache_update_str(hash, "pch-key");
+		cc_cache_update(hash, key, len);
+		free(key);
+		return 0;
+	}
+
+	fullpath[strlen(fullpath) - strlen(ORO_CC_CACHE_KEY_SUFFIX)] = 0;
+
+	int fd = open(fullpath, O_RDONLY);
+	if (fd == -1) return -1;
+
+	cc_cache_update_str(hash, "pch-contents");
+
+	char buf[65536];
+	for (;;) {
+		ssize_t r = read(fd, buf, sizeof(buf));
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			close(fd);
+			return -1;
+		}
+
+		if (r == 0) break;
+		cc_cache_update(hash, buf, (size_t) r);
+	}
+
+	close(fd);
+	return 0;
+}
+
+static void cc_cache_write_key(const char *out, const char *key) {
+	/*
+		Records the key of a precompiled header next to it
+		(`<out>.ccid`), for compiles that use it. Without a
+		key (an uncacheable compile), any stale one is removed.
+	*/
+	char keypath[ORO_CC_CACHE_PATH_MAX];
+	if (snprintf(keypath, sizeof(keypath), "%s" ORO_CC_CACHE_KEY_SUFFIX, out) >= (int) sizeof(keypath)) return;
+
+	if (key == NULL || write_if_changed(keypath, key, strlen(key)) < 0) {
+		unlink(keypath);
+	}
+}
+
+static int cc_cache_resolve(const char *name, char *resolved, size_t resolvedn) {
+	/*
+		Resolves an executable the way `execvp()` would,
+		searching `PATH` for names without a slash.
+	*/
+	if (strchr(name, '/') != NULL) {
+		if (snprintf(resolved, resolvedn, "%s", name) >= (int) resolvedn) return -1;
+		return 0;
+	}
+
+	const char *pathenv = getenv("PATH");
+	if (pathenv == NULL) pathenv = "/bin:/usr/bin";
+
+	while (*pathenv) {
+		const char *end = strchr(pathenv, ':');
+		size_t dirlen = end ? (size_t) (end - pathenv) : strlen(pathenv);
+
+		int n = dirlen == 0
+			? snprintf(resolved, resolvedn, "./%s", name)
+			: snprintf(resolved, resolvedn, "%.*s/%s", (int) dirlen, pathenv, name);
+
+		struct stat stats;
+		if (
+			n < (int) resolvedn
+			&& stat(resolved, &stats) == 0
+			&& S_ISREG(stats.st_mode)
+			&& access(resolved, X_OK) == 0
+		) {
+			return 0;
+		}
+
+		if (end == NULL) break;
+		pathenv = &end[1];
+	}
+
+	return -1;
+}
+
+static int cc_cache_update_compiler(struct cc_cache_hash *hash, char **command, int ncommand) {
+	/*
+		Hashes the compiler's resolved path and identity, so
+		that upgrading it invalidates its cached objects.
+
+		The command may start with launchers (e.g. `ccache gcc`
+		or `env FOO=1 gcc`), so every leading word up to the
+		first option that names an executable is hashed too.
+	*/
+	char resolved[ORO_CC_CACHE_PATH_MAX];
+
+	/* the command itself has to exist */
+	if (cc_cache_resolve(command[0], resolved, sizeof(resolved)) != 0) return -1;
+	cc_cache_update_str(hash, resolved);
+	if (cc_cache_update_identity(hash, resolved, "") != 0) return -1;
+
+	for (int i = 1; i < ncommand && command[i][0] != '-'; i++) {
+		struct stat stats;
+		if (
+			cc_cache_resolve(command[i], resolved, sizeof(resolved)) == 0
+			&& stat(resolved, &stats) == 0
+			&& S_ISREG(stats.st_mode)
+			&& access(resolved, X_OK) == 0
+		) {
+			cc_cache_update_str(hash, resolved);
+			if (cc_cache_update_identity(hash, resolved, "") != 0) return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int cc_cache_mkdirs(const char *dirpath) {
+	char path[ORO_CC_CACHE_PATH_MAX];
+	size_t len = strlen(dirpath);
+
+	if (len == 0 || len >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	memcpy(path, dirpath, len + 1);
+
+	for (size_t i = 1; i <= len; i++) {
+		if (path[i] != '/' && path[i] != 0) continue;
+
+		char c = path[i];
+		path[i] = 0;
+		if (mkdir(path, 0777) != 0 && errno != EEXIST) return -1;
+		path[i] = c;
+	}
+
+	return 0;
+}
+
+static int cc_cache_parse_size(const char *str, uint64_t *size) {
+	char *end;
+	errno = 0;
+	unsigned long long n = strtoull(str, &end, 10);
+	if (errno != 0 || end == str) return -1;
+
+	switch (*end) {
+	case 'T': case 't': n *= 1024; /* fallthrough */
+	case 'G': case 'g': n *= 1024; /* fallthrough */
+	case 'M': case 'm': n *= 1024; /* fallthrough */
+	case 'K': case 'k': n *= 1024; ++end; break;
+	case 0: break;
+	default: return -1;
+	}
+
+	if (*end != 0) return -1;
+
+	*size = (uint64_t) n;
+	return 0;
+}
+
+static int cc_cache_wait(pid_t pid) {
+	int wstatus;
+	while (waitpid(pid, &wstatus, 0) == -1) {
+		if (errno != EINTR) {
+			fprintf(stderr, "cc-cache: waitpid(): %s\n", strerror(errno));
+			return 1;
+		}
+	}
+
+	if (WIFEXITED(wstatus)) return WEXITSTATUS(wstatus);
+	return 128 + (WIFSIGNALED(wstatus) ? WTERMSIG(wstatus) : 0);
+}
+
+static int cc_cache_hash_preprocessed(struct cc_cache_hash *hash, char **command, int ncommand, const char *out, const char *depfile, int macros) {
+	/*
+		Runs `command` as `-E` (without its output, depfile
+		or compile-only arguments), hashing its stdout.
+		With `macros` (for precompiled headers, which
+		carry them), macro definitions are kept (`-dD`).
+	*/
+	char **args = malloc(sizeof(*args) * (size_t) (ncommand + 3));
+	if (args == NULL) abort(); /* TODO better error message */
+
+	int nargs = 0;
+	for (int i = 0; i < ncommand; i++) {
+		const char *arg = command[i];
+
+		if (strcmp(arg, "-c") == 0 || strcmp(arg, "-MD") == 0 || strcmp(arg, "-MMD") == 0) continue;
+
+		if (i + 1 < ncommand && (
+			(strcmp(arg, "-o") == 0 && strcmp(command[i + 1], out) == 0)
+			|| (strcmp(arg, "-MF") == 0 && strcmp(command[i + 1], depfile) == 0)
+		)) {
+			++i;
+			continue;
+		}
+
+		args[nargs++] = command[i];
+	}
+
+	args[nargs++] = "-E";
+	if (macros) args[nargs++] = "-dD";
+	args[nargs] = NULL;
+
+	int status = 1;
+	int fds[2];
+
+	if (pipe(fds) != 0) {
+		fprintf(stderr, "cc-cache: pipe(): %s\n", strerror(errno));
+		goto exit;
+	}
+
+	pid_t pid = fork();
+	if (pid == -1) {
+		fprintf(stderr, "cc-cache: fork(): %s\n", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		goto exit;
+	}
+
+	if (pid == 0) {
+		/* diagnostics are reported by the real compilation */
+		int devnull = open("/dev/null", O_WRONLY);
+		if (devnull != -1) dup2(devnull, 2);
+		dup2(fds[1], 1);
+		close(fds[0]);
+		close(fds[1]);
+		execvp(args[0], args);
+		_exit(127);
+	}
+
+	close(fds[1]);
+
+	char buf[64 * 1024];
+	for (;;) {
+		ssize_t r = read(fds[0], buf, sizeof(buf));
+		if (r < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "cc-cache: read(): %s\n", strerror(errno));
+			break;
 		}
+
+		if (r == 0) break;
+		cc_cache_update(hash, buf, (size_t) r);
 	}
-	lua_setglobal(L, "__ORO__");
 
+	close(fds[0]);
+	status = cc_cache_wait(pid);
+
+exit:
+	free(args);
+	return status;
+}
+
+static int cc_cache_restore(const char *from, const char *to, int outfd) {
 	/*
-		Set up the package search path.
-		In the case we `require` a directory,
-		look for the "index" at `<dir>/_.lua`.
+		Copies a cache entry into `to` (or `outfd`) without
+		its times, so Ninja sees a freshly built output, and
+		marks the entry as recently used.
 	*/
-	lua_getglobal(L, "package");
-	lua_pushfstring(L, "%s/?.lua;%s/?/_.lua", root_dir, root_dir);
-	lua_setfield(L, -2, "path");
-	lua_pop(L, 1);
+	int infd = open(from, O_RDONLY);
+	if (infd == -1) return 1;
 
-	if (luaL_loadfile(L, bootstrap_script) != 0) {
-		fprintf(stderr, "error: lua bootstrap failed: %s\n", lua_tostring(L, -1));
-		goto exit_close_state;
+	int status = 1;
+	struct stat stats;
+
+	if (fstat(infd, &stats) != 0) goto exit;
+
+	if (outfd != -1) {
+		status = cp_fd_readwrite(infd, outfd, 0, stats.st_size, from);
+	} else {
+		int fd = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+		if (fd == -1) {
+			fprintf(stderr, "cc-cache: open(): %s: %s\n", strerror(errno), to);
+			goto exit;
+		}
+
+		status = cp_fd(from, infd, &stats, fd);
+		close(fd);
 	}
 
-	if (lua_pcall(L, 0, 0, traceback_idx) != 0) {
-		fprintf(stderr, "error: %s\n", lua_tostring(L, -1));
-		goto exit_close_state;
+	if (status == 0) futimens(infd, NULL);
+
+exit:
+	close(infd);
+	return status;
+}
+
+static int cc_cache_store(const char *from, const char *to) {
+	char tmppath[ORO_CC_CACHE_PATH_MAX];
+	snprintf(tmppath, sizeof(tmppath), "%s.tmp.%ld", to, (long) getpid());
+
+	int infd = open(from, O_RDONLY);
+	if (infd == -1) return 1;
+
+	int status = 1;
+	struct stat stats;
+
+	int outfd = open(tmppath, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	if (outfd == -1) goto exit;
+
+	if (fstat(infd, &stats) == 0 && cp_fd(from, infd, &stats, outfd) == 0) {
+		status = 0;
 	}
 
-	status = 0;
+	close(outfd);
+
+	if (status == 0 && rename(tmppath, to) != 0) status = 1;
+	if (status != 0) unlink(tmppath);
 
-exit_close_state:
-	lua_close(L);
 exit:
+	close(infd);
 	return status;
 }
 
-static int main_touch(int argc, char *argv[]) {
-	assert(argc > 0);
+struct cc_cache_file {
+	char name[64];
+	off_t size;
+	time_t mtime;
+};
 
-	int status = 0;
+static int cc_cache_file_cmp(const void *a, const void *b) {
+	time_t ta = ((const struct cc_cache_file *) a)->mtime;
+	time_t tb = ((const struct cc_cache_file *) b)->mtime;
+	return (ta > tb) - (ta < tb);
+}
 
-	for (int i = 1; i < argc; i++) {
-		const char *filepath = argv[i];
+static void cc_cache_evict(const char *subdir, uint64_t maxsize) {
+	/*
+		Deletes the least recently used files in one
+		subdirectory until it fits within its share of
+		the cache size (as ccache does), so that a store
+		never has to scan the whole cache.
+	*/
+	DIR *dir = opendir(subdir);
+	if (dir == NULL) return;
 
-		int fd = open(filepath, O_WRONLY | O_CREAT | O_APPEND, 0644);
-		if (fd == -1) {
-			fprintf(stderr, "touch: open(): %s: %s\n", strerror(errno), filepath);
-			status = 1;
-			continue;
-		}
+	size_t cap = 64, count = 0;
+	struct cc_cache_file *files = malloc(sizeof(*files) * cap);
+	if (files == NULL) abort(); /* TODO better error message */
 
-		if (futimens(fd, NULL)) {
-			fprintf(stderr, "touch: futimes(): %s: %s\n", strerror(errno), filepath);
-			status = 1;
-		}
+	uint64_t total = 0;
+	char path[ORO_CC_CACHE_PATH_MAX];
+	struct dirent *ent;
 
-		if (close(fd) != 0) {
-			fprintf(stderr, "touch: warning: close(): %s: %s\n", strerror(errno), filepath);
-			// We don't count this as an error.
+	while ((ent = readdir(dir)) != NULL) {
+		if (ent->d_name[0] == '.' || strlen(ent->d_name) >= sizeof(files->name)) continue;
+
+		snprintf(path, sizeof(path), "%s/%s", subdir, ent->d_name);
+
+		struct stat stats;
+		if (stat(path, &stats) != 0 || !S_ISREG(stats.st_mode)) continue;
+
+		if (count == cap) {
+			cap *= 2;
+			files = realloc(files, sizeof(*files) * cap);
+			if (files == NULL) abort(); /* TODO better error message */
 		}
+
+		strcpy(files[count].name, ent->d_name);
+		files[count].size = stats.st_size;
+		files[count].mtime = stats.st_mtime;
+		total += (uint64_t) stats.st_size;
+		++count;
 	}
 
-	return status;
-}
+	closedir(dir);
 
-static int main_echo(int argc, char *argv[]) {
-	assert(argc > 0);
+	if (total > maxsize) {
+		qsort(files, count, sizeof(*files), &cc_cache_file_cmp);
 
-	const char *sep = "";
-	for (int i = 1; i < argc; i++) {
-		printf("%s%s", sep, argv[i]);
-		sep = " ";
+		/* leave some headroom so that every store doesn't evict */
+		uint64_t target = maxsize - maxsize / 10;
+
+		for (size_t i = 0; i < count && total > target; i++) {
+			snprintf(path, sizeof(path), "%s/%s", subdir, files[i].name);
+			if (unlink(path) == 0) total -= (uint64_t) files[i].size;
+		}
 	}
-	putc('\n', stdout);
 
-	return 0;
+	free(files);
 }
 
-static int main_init_depfile(int argc, char *argv[]) {
+static int main_cc_cache(int argc, char *argv[]) {
+	/*
+		cc-cache <dir> <maxsize> <out> <depfile> -- <command...>
+
+		Runs the compiler `command` that produces `out` and
+		`depfile`, through a local content-addressed cache
+		in `dir`.
+
+		The key covers the compiler's identity (its resolved
+		path, size and mtime, and those of the compiler behind
+		any launcher), the working directory, every
+		argument, and the preprocessed source (`command`
+		re-run with `-E`). On a hit, the
+		object, depfile and compiler diagnostics are restored
+		from the cache; on a miss, they are stored after a
+		successful compilation. `maxsize` (bytes, or with a
+		K/M/G/T suffix; 0 for unbounded) bounds the cache by
+		evicting the least recently used entries. Compiles
+		that read a PGO profile directory (GCC) or C++
+		modules bypass it.
+
+		Like `with-depfile`, the depfile always exists afterward.
+	*/
 	assert(argc > 0);
 
-	if (argc == 1) {
-		fputs("error: no output file given\n", stderr);
+	if (argc < 7 || strcmp(argv[5], "--") != 0) {
+		fputs("error: usage: cc-cache <dir> <maxsize> <out> <depfile> -- <command...>\n", stderr);
 		return 2;
 	}
 
-	if (argc > 2) {
-		fprintf(stderr, "error: expected exactly 1 argument; got %d\n", argc - 1);
+	const char *cachedir = argv[1];
+	const char *out = argv[3];
+	char *depfile = argv[4];
+	char **command = &argv[6];
+	int ncommand = argc - 6;
+
+	uint64_t maxsize;
+	if (cc_cache_parse_size(argv[2], &maxsize) != 0) {
+		fprintf(stderr, "error: cc-cache: invalid size: %s\n", argv[2]);
 		return 2;
 	}
 
-	char *filepath = argv[1];
-	if (*filepath == 0) {
-		fputs("error: filepath cannot be empty\n", stderr);
-		return 2;
+	struct cc_cache_hash hash = { ORO_FNV1A64_INIT, 0x6c62272e07bb0142ULL };
+	cc_cache_update_str(&hash, ORO_CC_CACHE_VERSION);
+
+	/* compiler identity (if it can't be found, neither can execvp()) */
+	int cacheable = cc_cache_update_compiler(&hash, command, ncommand) == 0;
+
+	/* precompiled headers' keys are recorded for their users */
+	int pch = 0;
+
+	/* relative paths (and debug info) depend on it */
+	char cwd[ORO_CC_CACHE_PATH_MAX];
+	if (getcwd(cwd, sizeof(cwd)) == NULL) cwd[0] = 0;
+	cc_cache_update_str(&hash, cwd);
+
+	for (int i = 0; i < ncommand; i++) {
+		cc_cache_update_str(&hash, command[i]);
+
+		size_t arglen = strlen(command[i]);
+		if (strncmp(command[i], "-x", 2) == 0 && arglen > 9 && strcmp(&command[i][arglen - 7], "-header") == 0) {
+			pch = 1;
+		} else if (strcmp(command[i], "-x") == 0 && i + 1 < ncommand) {
+			size_t langlen = strlen(command[i + 1]);
+			pch = pch || (langlen > 7 && strcmp(&command[i + 1][langlen - 7], "-header") == 0);
+		}
+
+		/* precompiled headers aren't part of the preprocessed source */
+		if (i + 1 < ncommand) {
+			if (strcmp(command[i], "-include-pch") == 0) {
+				cc_cache_update_pch(&hash, command[i + 1], "");
+			} else if (strcmp(command[i], "-include") == 0) {
+				cc_cache_update_pch(&hash, command[i + 1], ".gch");
+			}
+		}
+
+		/*
+			neither are PGO profiles; single-file (clang) profiles
+			are tracked, but profile directories (GCC) aren't.
+		*/
+		if (strncmp(command[i], "-fprofile-use", 13) == 0) {
+			struct stat stats;
+
+			if (
+				command[i][13] != '='
+				|| stat(&command[i][14], &stats) != 0
+				|| !S_ISREG(stats.st_mode)
+				|| cc_cache_update_identity(&hash, &command[i][14], "") != 0
+			) {
+				cacheable = 0;
+			}
+		}
+
+		/* nor are imported C++ modules (see `cxx-modules-collate`) */
+		if (strncmp(command[i], "-fmodule", 8) == 0 || command[i][0] == '@') {
+			cacheable = 0;
+		}
 	}
 
-	size_t len = strlen(filepath);
-	if (len < 3 || filepath[len-1] != 'd' || filepath[len-2] != '.') {
-		fprintf(stderr, "error: filepath must end with '.d': %s\n", filepath);
-		return 2;
+	if (cacheable) {
+		cacheable = cc_cache_hash_preprocessed(&hash, command, ncommand, out, depfile, pch) == 0;
 	}
 
-	int status = 1;
+	char subdir[ORO_CC_CACHE_PATH_MAX];
+	char objpath[ORO_CC_CACHE_PATH_MAX];
+	char deppath[ORO_CC_CACHE_PATH_MAX];
+	char errpath[ORO_CC_CACHE_PATH_MAX];
 
-	FILE *fd = fopen(filepath, "wb");
+	char key[33] = "";
 
-	if (fd == NULL) {
-		fprintf(stderr, "error: fopen(): %s: %s\n", strerror(errno), filepath);
-		goto exit;
-	}
+	if (cacheable) {
+		snprintf(key, sizeof(key), "%016llx%016llx", (unsigned long long) hash.a, (unsigned long long) hash.b);
 
-	filepath[len - 2] = 0;
+		snprintf(subdir, sizeof(subdir), "%s/%.2s", cachedir, key);
 
-	errno = 0;
-	if (fprintf(fd, "%s:\n", filepath) < 0) {
-		fprintf(stderr, "error: fprintf(): %s: %s\n", strerror(errno), filepath);
-		goto exit_close;
+		if (
+			snprintf(objpath, sizeof(objpath), "%s/%s.o", subdir, &key[2]) >= (int) sizeof(objpath)
+			|| snprintf(deppath, sizeof(deppath), "%s/%s.d", subdir, &key[2]) >= (int) sizeof(deppath)
+			|| snprintf(errpath, sizeof(errpath), "%s/%s.err", subdir, &key[2]) >= (int) sizeof(errpath)
+		) {
+			fprintf(stderr, "error: cc-cache: cache directory path too long: %s\n", cachedir);
+			return 2;
+		}
+
+		if (
+			access(objpath, F_OK) == 0
+			&& access(deppath, F_OK) == 0
+			&& cc_cache_restore(deppath, depfile, -1) == 0
+			&& cc_cache_restore(objpath, out, -1) == 0
+		) {
+			if (access(errpath, F_OK) == 0) cc_cache_restore(errpath, NULL, 2);
+			if (pch) cc_cache_write_key(out, key);
+			return 0;
+		}
 	}
 
-	status = 0;
+	int status = init_depfile(depfile);
+	if (status != 0) return status;
 
-exit_close:
-	fclose(fd);
-exit:
-	return status;
-}
+	/* diagnostics are both shown and kept for cache hits */
+	char errtmp[ORO_CC_CACHE_PATH_MAX];
+	snprintf(errtmp, sizeof(errtmp), "%s.err.tmp", out);
 
-static int cp_file_outfd(const char *from, int outfd) {
-	int status = 1;
+	int errfd = cacheable
+		? open(errtmp, O_RDWR | O_CREAT | O_TRUNC, 0666)
+		: -1;
 
-	FILE *inf = fopen(from, "rb");
-	if (inf == NULL) {
-		fprintf(stderr, "fopen(rb): %s: %s\n", strerror(errno), from);
-		goto exit;
+	int fds[2] = { -1, -1 };
+	if (errfd != -1 && pipe(fds) != 0) {
+		close(errfd);
+		unlink(errtmp);
+		errfd = -1;
 	}
 
-	int infd = fileno(inf);
-	assert(infd != -1); // should never happen.
+	pid_t pid = fork();
+	if (pid == -1) {
+		fprintf(stderr, "cc-cache: fork(): %s\n", strerror(errno));
+		return 1;
+	}
 
-	struct stat stats;
-	if (fstat(infd, &stats) != 0) {
-		fprintf(stderr, "fstat(): %s: %s\n", strerror(errno), from);
-		goto exit_close_inf;
+	if (pid == 0) {
+		if (errfd != -1) {
+			dup2(fds[1], 2);
+			close(fds[0]);
+			close(fds[1]);
+			close(errfd);
+		}
+
+		execvp(command[0], command);
+		fprintf(stderr, "cc-cache: execvp(): %s: %s\n", strerror(errno), command[0]);
+		_exit(127);
 	}
 
-	off_t offset = 0;
-	size_t remaining = stats.st_size;
-
-	while (offset >= 0 && remaining > 0) {
-		// If this is failing, it might mean you're on
-		// a kernel older than 2.6.33. Please open an
-		// issue if this is really a blocker for you.
-		// Likewise, a PR that adequately detected
-		// such a case and performed a byte-buffer copy
-		// would be accepted.
-		ssize_t sent = sendfile(outfd, infd, &offset, remaining);
-		if (sent < 0) {
-			fprintf(stderr, "sendfile(): %s: %s \n", strerror(errno), from);
-			goto exit_close_inf;
+	off_t errsize = 0;
+
+	if (errfd != -1) {
+		close(fds[1]);
+
+		char buf[4096];
+		for (;;) {
+			ssize_t r = read(fds[0], buf, sizeof(buf));
+			if (r < 0) {
+				if (errno == EINTR) continue;
+				break;
+			}
+
+			if (r == 0) break;
+
+			(void) !write(2, buf, (size_t) r);
+			if (write(errfd, buf, (size_t) r) == r) errsize += (off_t) r;
 		}
 
-		remaining -= (size_t) sent;
-		offset += sent;
+		close(fds[0]);
+		close(errfd);
 	}
 
-	if (remaining > 0) {
-		fprintf(stderr, "sendfile(): unexpected error (remaining > 0): %s\n", from);
-		goto exit_close_inf;
+	status = cc_cache_wait(pid);
+
+	if (status == 0 && cacheable && cc_cache_mkdirs(subdir) == 0) {
+		if (errsize > 0) {
+			cc_cache_store(errtmp, errpath);
+		} else {
+			unlink(errpath);
+		}
+
+		/* the object goes in last; it marks a complete entry */
+		if (cc_cache_store(depfile, deppath) == 0) {
+			cc_cache_store(out, objpath);
+		}
+
+		if (maxsize > 0) {
+			cc_cache_evict(subdir, maxsize / ORO_CC_CACHE_SUBDIRS);
+		}
 	}
 
-	status = 0;
+	if (errfd != -1) unlink(errtmp);
+
+	if (pch) cc_cache_write_key(out, status == 0 && cacheable ? key : NULL);
 
-exit_close_inf:
-	fclose(inf);
-exit:
 	return status;
 }
 
-static int cp_file(const char *from, const char *to) {
-#ifdef _WIN32
-	// PR welcome!
-#	error "`--syscall cp` is unsupported on Windows"
-#else
-	int status = 1;
+static int main_compdb(int argc, char *argv[]) {
+	/*
+		compdb <in> <out>
 
-	FILE *outf = fopen(to, "wb");
-	if (outf == NULL) {
-		fprintf(stderr, "fopen(wb): %s: %s\n", strerror(errno), to);
-		goto exit;
+		Copies the compilation database `in` (from `ninja -t
+		compdb`) to `out`, removing the `with-depfile` and
+		`cc-cache` wrappers from compile commands so that
+		tools see the compiler as the driver. `out` is only
+		rewritten if it changes.
+	*/
+	static const char *const wrappers[] = {
+		"--syscall with-depfile ",
+		"--syscall cc-cache "
+	};
+
+	assert(argc > 0);
+
+	if (argc != 3) {
+		fputs("error: usage: compdb <in> <out>\n", stderr);
+		return 2;
+	}
+
+	size_t len;
+	char *data = read_whole_file(argv[1], &len);
+	if (data == NULL) {
+		fprintf(stderr, "error: compdb: %s: %s\n", strerror(errno), argv[1]);
+		return 2;
 	}
 
-	int outfd = fileno(outf);
-	assert(outfd != -1); // should never happen.
+	/* Never longer than the input */
+	char *result = malloc(len + 1);
+	if (result == NULL) abort(); /* TODO better error message */
 
-	status = cp_file_outfd(from, outfd);
+	size_t o = 0;
+	size_t i = 0;
 
-	fclose(outf);
-exit:
+	while (i < len) {
+		static const char key[] = "\"command\":";
+		if (len - i < sizeof(key) - 1 || memcmp(&data[i], key, sizeof(key) - 1) != 0) {
+			result[o++] = data[i++];
+			continue;
+		}
+
+		memcpy(&result[o], &data[i], sizeof(key) - 1);
+		o += sizeof(key) - 1;
+		i += sizeof(key) - 1;
+
+		while (i < len && (data[i] == ' ' || data[i] == '\t')) result[o++] = data[i++];
+		if (i == len || data[i] != '"') continue;
+		result[o++] = data[i++];
+
+		/* `<harness> --syscall <wrapper> ... -- <command...>` */
+		size_t start = i;
+		while (i < len && data[i] != ' ' && data[i] != '"') ++i;
+
+		size_t end = 0;
+		if (i < len && data[i] == ' ') {
+			++i;
+			for (size_t w = 0; w < sizeof(wrappers) / sizeof(wrappers[0]); w++) {
+				size_t wlen = strlen(wrappers[w]);
+				if (len - i < wlen || memcmp(&data[i], wrappers[w], wlen) != 0) continue;
+
+				/* the separator, within the (JSON) string */
+				for (size_t j = i + wlen; j + 4 <= len && data[j] != '"'; j++) {
+					if (data[j] == '\\') {
+						++j;
+					} else if (memcmp(&data[j], " -- ", 4) == 0) {
+						end = j + 4;
+						break;
+					}
+				}
+				break;
+			}
+		}
+
+		/* unwrapped commands are copied as-is */
+		i = end != 0 ? end : start;
+	}
+
+	free(data);
+
+	int status = write_if_changed(argv[2], result, o) < 0;
+	if (status != 0) {
+		fprintf(stderr, "error: compdb: failed to write: %s\n", argv[2]);
+	}
+
+	free(result);
 	return status;
-#endif
 }
 
-static int main_cp(int argc, char *argv[]) {
+static int run_syscall(int argc, char *argv[]);
+
+static int batch_is_space(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static int main_batch(int argc, char *argv[]) {
+	/*
+		batch <rspfile>
+
+		Runs a list of syscall operations in a single process
+		(e.g. from a Ninja `rspfile`). Operations are separated
+		by newlines or `;` tokens; arguments are separated by
+		whitespace and may be single-quoted (without escapes)
+		to include whitespace. Stops at the first failure.
+	*/
 	assert(argc > 0);
 
-	if (argc < 3) {
-		fputs("error: usage: cp <inputs[...]> <output[_directory]>\n", stderr);
+	if (argc != 2) {
+		fputs("error: usage: batch <rspfile>\n", stderr);
 		return 2;
 	}
 
-	int failed = 0;
+	const char *rspfile = argv[1];
 
-	if (argc == 3) {
-		failed = cp_file(argv[1], argv[2]) != 0;
-	} else {
-		assert(argc > 3);
+	size_t len;
+	char *data = read_whole_file(rspfile, &len);
+	if (data == NULL) {
+		fprintf(stderr, "error: batch: %s: %s\n", strerror(errno), rspfile);
+		return 2;
+	}
 
-		const char *dirpath = argv[argc - 1];
-		int outdir = open(dirpath, O_DIRECTORY | O_PATH);
+	/* Unquoted tokens, each NUL-terminated; never longer than the input (+1) */
+	char *tokens = malloc(len + 1);
+	size_t cap = 16;
+	char **args = malloc(sizeof(*args) * cap);
+	if (tokens == NULL || args == NULL) abort(); /* TODO better error message */
 
-		if (outdir == -1) {
-			fprintf(stderr, "open(DIRECTORY): %s: %s\n", strerror(errno), dirpath);
-			failed = 1;
-		} else {
-			for (int i = 1, last = argc - 1; i < last; i++) {
-				const char *filename = argv[i];
-				const char *base = strrchr(filename, '/');
-				base = base ? &base[1] : filename;
-
-				int outfd = openat(outdir, base, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
-				if (outfd == -1) {
-					fprintf(stderr, "openat(): %s: %s/%s\n", strerror(errno), dirpath, base);
-					failed = 1;
-					continue;
+	int status = 0;
+	int nargs = 0;
+	int op = 0;
+	size_t o = 0;
+	size_t i = 0;
+
+	while (status == 0) {
+		while (i < len && batch_is_space(data[i])) ++i;
+
+		int end_of_input = i >= len;
+		int end_of_op = end_of_input
+			|| data[i] == '\n'
+			|| (data[i] == ';' && (i + 1 == len || batch_is_space(data[i + 1]) || data[i + 1] == '\n'));
+
+		if (end_of_op) {
+			if (nargs > 0) {
+				args[nargs] = NULL;
+				++op;
+
+				/* would replace this process */
+				if (strcmp(args[0], "with-depfile") == 0) {
+					fprintf(stderr, "error: batch: operation #%d (%s) cannot be batched: %s\n", op, args[0], rspfile);
+					status = 2;
+					break;
 				}
 
-				if (cp_file_outfd(filename, outfd) != 0) {
-					failed = 1;
+				status = run_syscall(nargs, args);
+				if (status != 0) {
+					fprintf(stderr, "error: batch: operation #%d (%s) failed: %s\n", op, args[0], rspfile);
 				}
 
-				close(outfd);
+				nargs = 0;
 			}
 
-			close(outdir);
+			if (end_of_input) break;
+			++i;
+			continue;
+		}
+
+		char *token = &tokens[o];
+
+		while (i < len && !batch_is_space(data[i]) && data[i] != '\n') {
+			if (data[i] == '\'') {
+				++i;
+				while (i < len && data[i] != '\'') tokens[o++] = data[i++];
+
+				if (i >= len) {
+					fprintf(stderr, "error: batch: unterminated quote: %s\n", rspfile);
+					status = 2;
+					break;
+				}
+
+				++i;
+			} else {
+				tokens[o++] = data[i++];
+			}
+		}
+
+		tokens[o++] = '\0';
+
+		if ((size_t) nargs + 1 >= cap) {
+			cap *= 2;
+			args = realloc(args, sizeof(*args) * cap);
+			if (args == NULL) abort(); /* TODO better error message */
 		}
+
+		args[nargs++] = token;
 	}
 
-	return failed;
+	free(args);
+	free(tokens);
+	free(data);
+	return status;
+}
+
+static int run_syscall(int argc, char *argv[]) {
+	if (strcmp(argv[0], "touch") == 0) return main_touch(argc, argv);
+	if (strcmp(argv[0], "pass") == 0) return 0;
+	if (strcmp(argv[0], "fail") == 0) return 1;
+	if (strcmp(argv[0], "echo") == 0) return main_echo(argc, argv);
+	if (strcmp(argv[0], "init-depfile") == 0) return main_init_depfile(argc, argv);
+	if (strcmp(argv[0], "with-depfile") == 0) return main_with_depfile(argc, argv);
+	if (strcmp(argv[0], "unity") == 0) return main_unity(argc, argv);
+	if (strcmp(argv[0], "cxx-modules-collate") == 0) return main_cxx_modules_collate(argc, argv);
+	if (strcmp(argv[0], "cp") == 0) return main_cp(argc, argv);
+	if (strcmp(argv[0], "write-if-changed") == 0) return main_write_if_changed(argc, argv);
+	if (strcmp(argv[0], "cc-cache") == 0) return main_cc_cache(argc, argv);
+	if (strcmp(argv[0], "batch") == 0) return main_batch(argc, argv);
+	if (strcmp(argv[0], "compdb") == 0) return main_compdb(argc, argv);
+
+	fprintf(stderr, "error: unknown syscall: %s\n", argv[0]);
+	return 2;
 }
 
 int main(int argc, char *argv[]) {
@@ -912,16 +4712,18 @@ int main(int argc, char *argv[]) {
 			return 2;
 		}
 
-		if (strcmp(argv[0], "touch") == 0) return main_touch(argc, argv);
-		if (strcmp(argv[0], "pass") == 0) return 0;
-		if (strcmp(argv[0], "fail") == 0) return 1;
-		if (strcmp(argv[0], "echo") == 0) return main_echo(argc, argv);
-		if (strcmp(argv[0], "init-depfile") == 0) return main_init_depfile(argc, argv);
-		if (strcmp(argv[0], "cp") == 0) return main_cp(argc, argv);
+		/*
+			NOTE: this happens before any Lua setup;
+			syscalls are just tiny standalone programs.
+		*/
+		return run_syscall(argc, argv);
+	}
 
-		fprintf(stderr, "error: unknown syscall: %s\n", argv[0]);
-		return 2;
+#ifndef _WIN32
+	if (argc > 1 && strcmp(argv[1], "--embed-lua") == 0) {
+		return main_embed_lua(argc - 1, argv + 1);
 	}
+#endif
 
 	return main_build(argc, argv);
 }
@@ -30,6 +30,11 @@ local escapeall = require 'internal.globals.rule.escapeall'
 local Path = (require 'internal.path-factory').Path
 local isinstance = require 'internal.util.isinstance'
 local flat = require 'internal.util.flat'
+local ExecuteCache = require 'internal.execute-cache'
+local ScriptCache = require 'internal.script-cache'
+local ModuleCache = require 'internal.module-cache'
+local Profile = require 'internal.profile'
+local lfs = require 'lfs'
 
 -- Read config variables from the command line
 local raw_config = {}
@@ -43,15 +48,19 @@ end
 -- Initialize build script environment
 io.stderr:write('(Re-)configuring project...\n')
 
+-- (a no-op unless `ORO_PROFILE` is set)
+Profile.begin('configure', 'configure')
+
 -- Create context and perform the build
 local ctx = make_context {
 	source_directory = P.dirname(Oro.absbuildscript),
 	build_directory = Oro.absbindir,
+	build_script = Oro.absbuildscript,
 	config = raw_config,
 	env = Oro.env
 }
 
-ctx.root_module:dofile(Oro.absbuildscript)
+ctx.root_module:load(Oro.absbuildscript)
 
 -- Notify user about unreferenced command line config
 -- values
@@ -76,11 +85,22 @@ local allphonies = List()
 local testphonies = List()
 local rootphonies = {}
 
-for _, module in pairs(ctx.modules) do
+-- Iterate in sorted order so that identical configurations
+-- produce byte-identical Ninja files (Lua's table order
+-- varies between runs).
+local function sortedkeys(tbl)
+	local ks = keys(tbl)
+	table.sort(ks)
+	return ks
+end
+
+for _, modulepath in ipairs(sortedkeys(ctx.modules)) do
+	local module = ctx.modules[modulepath]
 	local offsetpath = P.normalize(P.join('.', P.relpath(Oro.abssrcdir, module.root)))
 	local isroot = module == ctx.root_module
 
-	for name, v in pairs(module.exports) do
+	for _, name in ipairs(sortedkeys(module.exports)) do
+		local v = module.exports[name]
 		local label = escapeall(offsetpath .. ':' .. name)
 
 		local deps = List()
@@ -107,8 +127,8 @@ ctx.ninja:add_phony('all', allphonies)
 ctx.ninja:add_phony('test', testphonies)
 
 -- Hoist root module's phonies to 'naked' phonies
-for k,v in pairs(rootphonies) do
-	ctx.ninja:add_phony(k, {v})
+for _, k in ipairs(sortedkeys(rootphonies)) do
+	ctx.ninja:add_phony(k, {rootphonies[k]})
 end
 
 -- Make any root default export(s) the default target(s)
@@ -138,26 +158,64 @@ end
 add_build_dep(P.join(Oro.rootdir, 'oro-build.lua'))
 add_build_dep(P.join(Oro.rootdir, 'oro-build.c'))
 
-for _, srcpath in ipairs(keys(ctx.modules)) do
+for _, srcpath in ipairs(sortedkeys(ctx.modules)) do
 	add_build_dep(P.relpath(Oro.abssrcdir, srcpath))
 end
 
+-- Each module's builds are written to their own Ninja file
+-- (named after its script; see internal.module-cache),
+-- included by build.ninja along with the shared rules,
+-- pools and phonies. Files are only rewritten when their
+-- contents change, so that editing one module leaves the
+-- others' files (and Ninja's view of them) untouched.
+local modulefiles = List()
+local moduleswritten = false
+
+for _, pathname in ipairs(sortedkeys(ctx.modules)) do
+	local module = ctx.modules[pathname]
+
+	if #module.ninja.builds > 0 then
+		local modulefile = ModuleCache.ninjafile(module.pathname)
+		local modulepath = P.join(Oro.bindir, modulefile)
+
+		ModuleCache.mkdirs(P.dirname(modulepath))
+		if module.ninja:write(modulepath) then
+			moduleswritten = true
+		end
+
+		ctx.ninja:add_subninja(modulefile)
+		modulefiles[nil] = modulefile
+	end
+end
+
 -- Add default generation rule (so that any config files
 -- are checked in order to re-config)
 ctx.ninja:add_rule('_oro_build_regenerator', {
 	command = { 'cd', P.currentdir(), '&&', 'env', '_ORO_BUILD_REGEN=1', Oro.buildscript, Oro.bindir, unpack(Oro.arg) },
 	description = { 'Reconfigure', Oro.bindir },
-	generator = '1'
+	generator = '1',
+	-- build.ninja is only rewritten when it changes
+	restat = '1'
 })
 
+-- The module files are outputs too, so that Ninja
+-- regenerates them if they go missing.
 ctx.ninja:add_build('_oro_build_regenerator', {
 	out = 'build.ninja',
+	out_implicit = modulefiles,
 	config_deps
 })
 
--- Add compilation database generation rule.
+-- Add compilation database generation rule. The harness
+-- strips its compile wrappers (e.g. the object cache) so
+-- that tools see the compiler itself.
+local harness = P.relpath(Oro.absbindir, Oro.absharnesspath)
 ctx.ninja:add_rule('_oro_build_compdb', {
-	command = { 'ninja', '-t', 'compdb', '>', '$out' },
+	command = {
+		'ninja', '-t', 'compdb', '>', '$out.raw',
+		'&&', harness, '--syscall', 'compdb', '$out.raw', '$out',
+		'&&', 'rm', '-f', '$out.raw'
+	},
 	description = 'COMPDB $out'
 })
 
@@ -168,11 +226,25 @@ ctx.ninja:add_build('_oro_build_compdb', {
 
 -- Dump Ninja file to build directory
 local ninja_out = P.join(Oro.bindir, 'build.ninja')
-local ostream = io.open(ninja_out, 'wb')
-ctx.ninja:write(ostream)
-ostream:close()
+if not ctx.ninja:write(ninja_out) and moduleswritten then
+	-- Ninja only reloads its manifest if build.ninja itself
+	-- changed (the regenerator is `restat`), which it has to
+	-- whenever any of the files it includes did.
+	lfs.touch(ninja_out)
+end
+
+-- Persist any cached `oro.execute{cache=true}` results
+-- (keeping those of commands that replayed modules
+-- didn't run this time)
+ExecuteCache.save(ModuleCache.replays() == 0)
+
+Profile.finish()
+Profile.save()
 
 -- Done!
+ScriptCache.report(io.stderr)
+ModuleCache.report(io.stderr)
+Profile.report(io.stderr)
 io.stderr:write('OK, configured: ' .. Oro.absbindir .. '\n')
 if os.getenv('_ORO_BUILD_REGEN') == nil then
 	io.stderr:write('You should now run: ninja -C \''..Oro.bindir..'\'\n')
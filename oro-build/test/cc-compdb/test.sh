@@ -0,0 +1,9 @@
+# Without and with the object cache
+for cache in 0 "$PWD/bin/cache"; do
+	./build.oro bin CC_CACHE="$cache"
+	ninja -C bin compile_commands.json
+	grep -q '"file": "[^"]*main.c"' bin/compile_commands.json || fail "main.c missing from compile_commands.json"
+	grep -q -- '--syscall' bin/compile_commands.json && fail "compile wrapper leaked into compile_commands.json"
+	[ ! -e bin/compile_commands.json.raw ] || fail "stale bin/compile_commands.json.raw"
+done
+true
@@ -0,0 +1,10 @@
+./build.oro bin
+grep -q '^pool oro_lto$' bin/build.ninja || fail 'missing LTO pool'
+grep -q 'pool = oro_lto' bin/build.ninja || fail 'link rule is not in the LTO pool'
+grep -q -- '-flto' bin/.oro/modules/*.ninja || fail 'missing LTO flags'
+ninja -C bin
+./bin/app || fail 'bin/app did not run correctly'
+grep -q -- '-fuse-ld' bin/.oro/modules/*.ninja && fail 'full LTO forces a linker'
+# C.LTO_LINKER picks the linker
+./build.oro bin LTO_LINKER=bfd
+grep -q -- '-fuse-ld=bfd' bin/.oro/modules/*.ninja || fail 'C.LTO_LINKER is not used'
@@ -0,0 +1 @@
+int value(void) { return 42; }
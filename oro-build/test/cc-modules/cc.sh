@@ -0,0 +1,66 @@
+#!/bin/sh
+# A stand-in for a module-aware GCC, which scans (`-fdeps-file`)
+# and compiles sources by their `export module`/`import` lines.
+# Every scan and compilation is logged to `cc.log`.
+
+if [ "$1" = --version ]; then
+	echo 'gcc (stand-in) 14.0.0'
+	exit 0
+fi
+
+echo "$*" >> cc.log
+
+out= dep= deps= mapper= src=
+while [ $# -gt 0 ]; do
+	case "$1" in
+		-o) out="$2"; shift;;
+		-MF) dep="$2"; shift;;
+		-MT|-x) shift;;
+		-fdeps-file=*) deps="${1#*=}";;
+		-fmodule-mapper=*) mapper="${1#*=}";;
+		-*) ;;
+		*) src="$1";;
+	esac
+	shift
+done
+
+provides="$(sed -n 's/^export module \([^;]*\);.*/\1/p' "$src")"
+requires="$(sed -n 's/^\(export \)\{0,1\}import \([^;]*\);.*/\2/p' "$src")"
+
+names() {
+	sep=
+	for name in $1; do
+		printf '%s{"logical-name": "%s"}' "$sep" "$name"
+		sep=', '
+	done
+}
+
+if [ -n "$deps" ]; then
+	printf '{"rules": [{"provides": [%s], "requires": [%s]}], "version": 1}\n' \
+		"$(names "$provides")" "$(names "$requires")" > "$deps"
+	printf '%s: %s\n' "$deps" "$src" > "$dep"
+	: > "$out"
+	exit 0
+fi
+
+# Unmapped imports (e.g. `std`) are the compiler's own
+for name in $requires; do
+	bmi="$(sed -n "s/^$name //p" "$mapper")"
+	if [ -n "$bmi" ] && [ ! -f "$bmi" ]; then
+		echo "missing BMI: $bmi" >&2
+		exit 1
+	fi
+done
+
+for name in $provides; do
+	bmi="$(sed -n "s/^$name //p" "$mapper")"
+	if [ -z "$bmi" ]; then
+		echo "no BMI mapped for: $name" >&2
+		exit 1
+	fi
+	mkdir -p "$(dirname "$bmi")"
+	echo "$name" > "$bmi"
+done
+
+printf '%s: %s\n' "$out" "$src" > "$dep"
+echo "$src" > "$out"
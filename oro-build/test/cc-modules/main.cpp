@@ -0,0 +1,5 @@
+import math;
+
+int main() {
+	return square(2) - 4;
+}
@@ -0,0 +1,6 @@
+export module math;
+import std;
+
+export int square(int x) {
+	return x * x;
+}
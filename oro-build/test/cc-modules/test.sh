@@ -0,0 +1,16 @@
+./build.oro bin CC="$PWD/cc.sh"
+grep -q 'imports = -- .*math.cppm.o.ddi' bin/.oro/modules/*.ninja || fail 'main.cpp is not collated with the scans of math.cppm'
+ninja -C bin
+[ -f bin/math.cppm.o ] || fail 'not found: bin/math.cppm.o'
+[ -f bin/main.cpp.o ] || fail 'not found: bin/main.cpp.o'
+# Scans and compiles are C++, whatever the extension
+grep -q -- '-xc\( \|$\)' bin/cc.log && fail 'module sources were compiled as C'
+[ "$(grep -c -- '-xc++ ' bin/cc.log)" = "4" ] || fail 'expected two scans and two compiles as C++'
+# The program imports the library's BMI; `std` is left to the compiler
+grep -q '^math .*/math\.gcm$' bin/main.cpp.o.modmap || fail 'main.cpp.o does not import math'
+grep -q '^std ' bin/math.cppm.o.modmap && fail 'std was mapped to a BMI'
+ninja -C bin -n | grep -q 'no work to do' || fail 'not up to date'
+# A changed interface rebuilds its importers
+touch math.cppm
+ninja -C bin -n | grep -q 'main.cpp.o' || fail 'main.cpp.o is not rebuilt after its import changed'
+true
@@ -0,0 +1 @@
+int a(void) { return prelude_value(); }
@@ -0,0 +1 @@
+int c(void) { return prelude_value(); }
@@ -0,0 +1,5 @@
+#ifndef VALUE
+#	define VALUE 1
+#endif
+
+static inline int prelude_value(void) { return VALUE; }
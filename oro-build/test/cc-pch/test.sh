@@ -0,0 +1,30 @@
+./build.oro bin
+ninja -C bin
+[ -f bin/a.c.o ] || fail 'not found: bin/a.c.o'
+[ -f bin/b.c.o ] || fail 'not found: bin/b.c.o'
+[ -f bin/c.c.o ] || fail 'not found: bin/c.c.o'
+[ "$(find bin/.pch -name 'prelude.h.?ch' | wc -l)" = "2" ] || fail 'expected two precompiled headers'
+# Changing the header rebuilds it and every object that uses it
+touch prelude.h
+ninja -C bin > bin/ninja.log
+grep -q 'a.c.o' bin/ninja.log || fail 'a.c.o was not rebuilt'
+grep -q 'c.c.o' bin/ninja.log || fail 'c.c.o was not rebuilt'
+ninja -C bin -n | grep -q 'no work to do' || fail 'not up to date'
+# With the object cache, a clean build is all hits, even though
+# the precompiled headers are rebuilt (with new mtimes)
+printf '#!/bin/sh\ncase "$*" in *" -E"|*" -E -dD") ;; *) echo "$*" >> %s/bin/compile.log;; esac\nexec cc "$@"\n' "$PWD" > bin/logcc
+chmod +x bin/logcc
+./build.oro bin CC="$PWD/bin/logcc" CC_CACHE="$PWD/bin/cache"
+ninja -C bin
+compiles="$(wc -l < bin/compile.log)"
+ninja -C bin -t clean
+rm -rf bin/.pch
+sleep 1
+ninja -C bin
+[ "$(wc -l < bin/compile.log)" = "$compiles" ] || fail 'clean build missed the object cache'
+# ... but a macro change in the header is a miss
+cp prelude.h bin/prelude.h.orig
+sed -i 's/define VALUE 1/define VALUE 3/' prelude.h
+ninja -C bin
+cp bin/prelude.h.orig prelude.h
+[ "$(wc -l < bin/compile.log)" -gt "$compiles" ] || fail 'header macro change hit the object cache'
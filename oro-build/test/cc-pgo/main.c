@@ -0,0 +1,16 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+long value(long i);
+
+int main(int argc, char *argv[]) {
+	long n = argc > 1 ? atol(argv[1]) : 10;
+	long sum = 0;
+
+	for (long i = 0; i < n; i++) {
+		sum += value(i);
+	}
+
+	printf("%ld\n", sum);
+	return 0;
+}
@@ -0,0 +1,11 @@
+./build.oro bin
+ninja -C bin
+[ -f bin/.pgo/app/gen/main.c.o ] || fail 'missing instrumented object'
+[ -f bin/.pgo/app/use/main.c.o ] || fail 'missing optimized object'
+[ -s bin/.pgo/app/profile ] || fail 'missing merged profile'
+grep -q 'main.c.gcda' bin/.pgo/app/profile || fail 'training wrote no profile'
+[ "$(./bin/app 10)" = "24" ] || fail 'bin/app did not run correctly'
+ninja -C bin -n | grep -q 'no work to do' || fail 'PGO build is not up to date'
+# Identical training leaves the optimized build alone
+ninja -C bin train
+ninja -C bin -n | grep -q 'no work to do' || fail 'unchanged profile caused a rebuild'
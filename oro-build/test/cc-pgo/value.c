@@ -0,0 +1 @@
+long value(long i) { return (i % 3 == 0) ? i : 1; }
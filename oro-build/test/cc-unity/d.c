@@ -0,0 +1,2 @@
+static int helper(void) { return 4; }
+int d(void) { return helper(); }
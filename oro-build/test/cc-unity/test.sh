@@ -0,0 +1,15 @@
+./build.oro bin
+ninja -C bin
+[ "$(ls bin/.unity/*.c | wc -l)" = "1" ] || fail 'expected exactly one unity translation unit'
+grep -q '"../../a.c"' bin/.unity/*.c || fail 'unity unit does not include a.c'
+grep -q '"../../b.c"' bin/.unity/*.c || fail 'unity unit does not include b.c'
+[ -f bin/.unity/*.c.o ] || fail 'unity unit was not compiled'
+[ ! -e bin/a.c.o ] || fail 'a.c was compiled on its own'
+[ -f bin/c.c.o ] || fail 'not found: bin/c.c.o'
+[ -f bin/d.c.o ] || fail 'not found: bin/d.c.o'
+# Source changes rebuild the unit (but don't regenerate it)
+touch b.c
+ninja -C bin > bin/ninja.log
+grep -q 'UNITY' bin/ninja.log && fail 'unity unit was regenerated'
+grep -q '.unity/.*\.c\.o' bin/ninja.log || fail 'unity unit was not rebuilt'
+ninja -C bin -n | grep -q 'no work to do' || fail 'not up to date'
@@ -0,0 +1,9 @@
+ORO_BUILD_EMBED=1 ./build.oro bin
+[ -f bin/.oro/embedded-lua.h ] || fail "missing bin/.oro/embedded-lua.h"
+grep -q '"internal.util.flat"' bin/.oro/embedded-lua.h || fail "internal modules were not embedded"
+grep -q '"path.fs"' bin/.oro/embedded-lua.h || fail "lua-path was not embedded"
+ninja -C bin
+[ -f bin/foo ] || fail "missing bin/foo"
+# Switching embedding back off rebuilds a plain harness
+./build.oro bin
+[ ! -f bin/.oro/embedded-lua.h ] || fail "bin/.oro/embedded-lua.h should have been removed"
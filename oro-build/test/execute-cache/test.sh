@@ -0,0 +1,35 @@
+mkdir -p bin/path
+cp "$(command -v sh)" bin/tool
+cp "$(command -v sh)" bin/path/wrapped
+printf '#!/bin/sh\nexec "$@"\n' > bin/launcher
+chmod +x bin/launcher
+export PATH="$PWD/bin/path:$PATH"
+runs() { wc -l < bin/runs | tr -d ' '; }
+wrapped_runs() { wc -l < bin/wrapped-runs | tr -d ' '; }
+configure() { ./build.oro bin >bin/configure.log 2>&1 || (cat bin/configure.log; false); }
+
+LANG=C configure
+[ "$(runs)" = 1 ] || fail "expected a miss on the first configure"
+grep -q '^result: C/$' bin/configure.log || fail "unexpected result"
+
+LANG=C ORO_TEST_UNRELATED=1 configure
+[ "$(runs)" = 1 ] || fail "expected a hit (unrelated variables aren't keyed)"
+grep -q '^result: C/$' bin/configure.log || fail "expected the cached result"
+
+LANG=C.UTF-8 configure
+[ "$(runs)" = 2 ] || fail "expected a miss after changing LANG"
+
+LANG=C.UTF-8 ORO_TEST_OBSERVED=1 configure
+[ "$(runs)" = 3 ] || fail "expected a miss after changing a \`cacheenv\` variable"
+grep -q '^result: C.UTF-8/1$' bin/configure.log || fail "unexpected result"
+
+touch -d '2000-01-01' bin/tool
+LANG=C.UTF-8 ORO_TEST_OBSERVED=1 configure
+[ "$(runs)" = 4 ] || fail "expected a miss after replacing the executable"
+
+# Launched executables are keyed too
+[ "$(wrapped_runs)" = 2 ] || fail "expected the wrapped tool to only miss on LANG changes"
+touch -d '2000-01-01' bin/path/wrapped
+LANG=C.UTF-8 ORO_TEST_OBSERVED=1 configure
+[ "$(wrapped_runs)" = 3 ] || fail "expected a miss after replacing the wrapped executable"
+[ "$(runs)" = 4 ] || fail "expected a hit for bin/tool"
@@ -0,0 +1,53 @@
+# Scripts edited below are restored on exit
+mkdir -p bin/orig
+cp build.oro bin/orig/build.oro
+cp leaf/build.oro bin/orig/leaf.oro
+restore() { cp bin/orig/build.oro build.oro; cp bin/orig/leaf.oro leaf/build.oro; }
+trap restore EXIT
+
+evaluated() { tr '\n' ' ' < bin/evaluated; }
+regen() {
+	rm -f bin/evaluated
+	touch bin/evaluated
+	ninja -C bin all >bin/ninja.log 2>&1 || (cat bin/ninja.log; false)
+}
+
+./build.oro bin
+[ "$(evaluated)" = "root leaf other reader " ] || fail 'expected every module to be evaluated'
+[ -f bin/.oro/modules/build.oro.ninja ] || fail 'missing root module file'
+[ -f bin/.oro/modules/leaf/build.oro.ninja ] || fail 'missing leaf module file'
+grep -q '^subninja .oro/modules/leaf/build.oro.ninja$' bin/build.ninja || fail 'leaf module file is not included'
+grep -q 'leaf.txt' bin/.oro/modules/leaf/build.oro.ninja || fail 'leaf build is missing'
+grep -q 'leaf.txt' bin/.oro/modules/build.oro.ninja && fail 'leaf build is in the root module file'
+grep -q '^build build.ninja | .*\.oro/modules/leaf/build.oro.ninja' bin/build.ninja || fail 'module files are not regenerator outputs'
+ninja -C bin all
+[ "$(cat bin/reader/copy.txt)" = "hello" ] || fail 'unexpected bin/reader/copy.txt'
+
+# Unchanged scripts are replayed
+touch other/build.oro
+regen
+[ "$(evaluated)" = "" ] || fail "expected no evaluations; got: $(evaluated)"
+grep -q 'Module cache: 4 replayed, 0 evaluated' bin/ninja.log || fail 'expected four replays'
+
+# An edited module is evaluated along with its importer
+echo '-- edited' >> leaf/build.oro
+regen
+[ "$(evaluated)" = "root leaf " ] || fail "expected root and leaf; got: $(evaluated)"
+
+# So are modules that read what it shared
+sed -i "s/'leaf.txt'/'leaf2.txt'/" leaf/build.oro
+regen
+[ "$(evaluated)" = "root leaf reader " ] || fail "expected root, leaf and reader; got: $(evaluated)"
+[ -f bin/leaf/leaf2.txt ] || fail 'missing bin/leaf/leaf2.txt'
+
+# ... and modules whose inherited config changed. Only the
+# leaf's module file changes, which Ninja has to reload.
+sed -i "s/'hello'/'howdy'/" build.oro
+regen
+[ "$(evaluated)" = "root leaf " ] || fail "expected root and leaf; got: $(evaluated)"
+[ "$(cat bin/reader/copy.txt)" = "howdy" ] || fail 'module file changes were not picked up'
+
+# Explicit reconfigures evaluate everything
+rm -f bin/evaluated
+./build.oro bin
+[ "$(evaluated)" = "root leaf other reader " ] || fail 'expected every module to be evaluated'
@@ -0,0 +1,8 @@
+./build.oro bin
+cp bin/build.ninja bin/first.ninja
+touch -d '2000-01-01 00:00:00' bin/build.ninja
+./build.oro bin
+[ "$(date -r bin/build.ninja +%Y)" = "2000" ] || fail "unchanged build.ninja was rewritten"
+(diff --color=always -c bin/first.ninja bin/build.ninja) || fail "reconfigure changed bin/build.ninja"
+ninja -C bin
+ninja -C bin -n | grep -q 'no work to do' || fail "second ninja run was not a no-op"
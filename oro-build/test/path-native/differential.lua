@@ -0,0 +1,144 @@
+--
+-- Differential test of the native path functions
+-- (backing `internal.path`) against the previous
+-- lua-path based implementations.
+--
+-- Run as the harness's bootstrap script (see test.sh).
+--
+
+local Oro = require 'internal.oro'
+local P = require 'internal.path'
+local LP = (require 'path').new('/')
+
+-- The previous implementations, verbatim.
+local ref = {}
+
+function ref.join(...)
+	local leafs = {}
+	for _, v in ipairs{...} do
+		if v ~= nil then
+			local vs = tostring(v)
+			if #vs > 0 then
+				leafs[#leafs + 1] = vs
+			end
+		end
+	end
+	return LP.join(table.unpack(leafs))
+end
+
+function ref.normalize(pth)
+	return LP.remove_dir_end(LP.normalize(pth))
+end
+
+local function asabs(pth)
+	if LP.isabs(pth) then return pth end
+	return ref.join('/', pth)
+end
+
+local function asrel(pth)
+	if LP.isabs(pth) then
+		if pth == '/' then return '' end
+		return ref.join(LP.splitroot(pth))
+	end
+	return pth
+end
+
+function ref.relpath(from, to)
+	from = ref.normalize(from)
+	to = ref.normalize(to)
+
+	if from == to then
+		return '.'
+	end
+
+	while true do
+		local f_leaf, f_path = LP.splitroot(from)
+		local t_leaf, t_path = LP.splitroot(to)
+
+		if f_leaf == t_leaf then
+			from = asabs(f_path)
+			to = asabs(t_path)
+		else
+			break
+		end
+	end
+
+	from = ref.normalize(asrel(from))
+	to = ref.normalize(asrel(to))
+
+	local joins = {}
+
+	while true do
+		if from == '' then
+			break
+		else
+			joins[#joins + 1] = '..'
+		end
+
+		from = LP.dirname(from)
+	end
+
+	joins[#joins + 1] = to
+
+	return ref.normalize(ref.join(table.unpack(joins)))
+end
+
+ref.splitext = LP.splitext
+ref.basename = LP.basename
+ref.dirname = LP.dirname
+
+local paths = {
+	'.', './', 'foo', 'foo/', './foo', './foo/buzz/bar', 'foo//bar',
+	'foo/./bar', 'foo/../bar', 'foo/bar/..', '../foo', '../../foo/../bar',
+	'./../foo', '/', '/foo', '/foo/', '/foo/bar/../baz', '/foo/../..',
+	'foo.iso', './foo.iso.flag', 'foo.tar.gz', '.bashrc', 'dir/.hidden',
+	'a.b/c', 'foo/bar.', 'foo..c', 'dir/sub.d/', '/abs/path/file.c.o'
+}
+
+local abspaths = {
+	'/', '/a', '/a/', '/a/b', '/a/b/c', '/a/c/d', '/a/./b/../c',
+	'/x/y/z', '/a/bc', '/a/b/c/d/e'
+}
+
+local failures = 0
+
+local function check(name, args, ...)
+	local expected = table.pack(ref[name](table.unpack(args)))
+	local actual = table.pack(P[name](table.unpack(args)))
+
+	for i = 1, math.max(expected.n, actual.n) do
+		if expected[i] ~= actual[i] then
+			failures = failures + 1
+			local quoted = {}
+			for j, v in ipairs(args) do quoted[j] = string.format('%q', v) end
+			io.stderr:write(string.format(
+				'MISMATCH: %s(%s) [%d]: expected %q, got %q\n',
+				name, table.concat(quoted, ', '), i,
+				tostring(expected[i]), tostring(actual[i])
+			))
+		end
+	end
+end
+
+for _, p in ipairs(paths) do
+	check('normalize', {p})
+	check('splitext', {p})
+	check('basename', {p})
+	check('dirname', {p})
+	check('join', {'.', p})
+	check('join', {'..', p, 'x'})
+	check('join', {'', p})
+	check('join', {p, ''})
+end
+
+for _, from in ipairs(abspaths) do
+	for _, to in ipairs(abspaths) do
+		check('relpath', {from, to})
+	end
+end
+
+if failures > 0 then
+	error(tostring(failures) .. ' mismatch(es) between the native and lua-path implementations')
+end
+
+io.stderr:write('OK: native path functions match lua-path (' .. Oro.bindir .. ')\n')
@@ -0,0 +1,3 @@
+./build.oro bin
+ninja -C bin
+bin/.oro/build ../.. bin differential.lua differential.lua
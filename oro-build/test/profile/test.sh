@@ -0,0 +1,13 @@
+mkdir -p bin
+./build.oro bin 2>bin/configure.log || (cat bin/configure.log; false)
+[ ! -f bin/.oro/profile.json ] || fail "profiled without ORO_PROFILE"
+ORO_PROFILE=1 ./build.oro bin 2>bin/configure.log || (cat bin/configure.log; false)
+grep -q 'Configure profile:' bin/configure.log || fail "missing profile summary"
+grep -Eq ' 1 +0 +1  build\.oro$' bin/configure.log || fail "expected one execute and build in build.oro"
+# (the touch rule is shared, and defined by sub.oro first)
+grep -Eq ' 0 +1 +1  sub\.oro$' bin/configure.log || fail "expected one rule and build in sub.oro"
+grep -q '"traceEvents"' bin/.oro/profile.json || fail "missing Chrome trace"
+grep -q '"name":"import \.sub","cat":"importlocal"' bin/.oro/profile.json || fail "missing import span"
+grep -q '"cat":"ninja"' bin/.oro/profile.json || fail "missing Ninja write span"
+ninja -C bin
+[ -f bin/root.txt ] || fail "missing bin/root.txt"
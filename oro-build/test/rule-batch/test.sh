@@ -0,0 +1,16 @@
+# A copied file older than the edge's other inputs
+touch -d '2000-01-01 00:00:00' hello.txt
+./build.oro bin
+grep -q 'rspfile = ' bin/build.ninja || fail "batch rule is missing rspfile"
+ninja -C bin > bin/ninja.log
+[ "$(grep -c 'BATCH' bin/ninja.log)" = "1" ] || fail "expected exactly one batch edge"
+[ -f bin/stamp ] || fail "missing bin/stamp"
+(diff --color=always -c hello.txt bin/hello.txt) || fail "unexpected contents: bin/hello.txt"
+(diff --color=always -c 'with space.txt' 'bin/copied space.txt') || fail "unexpected contents: bin/copied space.txt"
+ninja -C bin -n | grep -q 'no work to do' || fail "batch edge is not up to date"
+# Handwritten response files; stops at the first failure
+printf "touch a b\n; echo 'x y' ;\ntouch c ; fail\ntouch d\n" > bin/ops.rsp
+(cd bin && .oro/build --syscall batch ops.rsp) && fail "batch did not fail"
+[ -f bin/a ] && [ -f bin/b ] && [ -f bin/c ] || fail "batch did not run leading operations"
+[ ! -e bin/d ] || fail "batch did not stop at the first failure"
+true
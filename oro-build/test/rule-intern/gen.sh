@@ -0,0 +1 @@
+echo generated > "$1"
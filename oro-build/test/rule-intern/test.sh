@@ -0,0 +1,4 @@
+./build.oro bin
+[ "$(grep -c '^rule R' bin/build.ninja)" = "3" ] || fail 'identical rules were not interned'
+ninja -C bin
+[ -f bin/a.txt ] && [ -f bin/b.txt ] && [ -f bin/c.txt ] && [ -f bin/d.txt ] && [ -f bin/e.txt ] && [ -f bin/f.txt ] || fail 'missing outputs'
@@ -0,0 +1,10 @@
+./build.oro bin
+grep -A1 '^pool heavy$' bin/build.ninja | grep -q 'depth = 2' || fail 'missing pool heavy'
+grep -A1 '^pool single$' bin/build.ninja | grep -q 'depth = 1' || fail 'missing pool single'
+grep -q '^pool console' bin/build.ninja && fail 'built-in console pool was declared'
+grep -q 'pool = heavy' bin/build.ninja || fail 'rule is not in pool heavy'
+grep -A3 '^build b.txt' bin/.oro/modules/build.oro.ninja | grep -q 'pool = single' || fail 'build is not in pool single'
+[ "$(grep -c 'pool = console' bin/.oro/modules/build.oro.ninja)" = "2" ] || fail 'expected two console builds'
+ninja -C bin
+[ -f bin/a.txt ] && [ -f bin/b.txt ] && [ -f bin/c.txt ] || fail 'missing outputs'
+ninja -C bin shell || fail 'console phony failed'
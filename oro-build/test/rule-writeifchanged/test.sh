@@ -0,0 +1,17 @@
+./build.oro bin
+grep -q 'restat = 1' bin/build.ninja || fail "writeifchanged rule is missing restat"
+ninja -C bin
+(diff --color=always -c input.txt bin/gen.txt) || fail "unexpected contents: bin/gen.txt"
+(diff --color=always -c input.txt bin/copy.txt) || fail "unexpected contents: bin/copy.txt"
+(diff --color=always -c input.txt "bin/it's gen.txt") || fail "unexpected contents: bin/it's gen.txt"
+(diff --color=always -c input.txt "bin/it's gen.txt.stamp") || fail "unexpected contents: bin/it's gen.txt.stamp"
+# Force the generators to re-run; their outputs don't change
+touch -d '2000-01-01 00:00:00' bin/gen.txt "bin/it's gen.txt.stamp"
+ninja -C bin > bin/ninja.log
+grep -q 'GEN' bin/ninja.log || fail "generator did not re-run"
+grep -q 'QUOTED' bin/ninja.log || fail "quoted generator did not re-run"
+grep -q 'COPY' bin/ninja.log && fail "downstream copy was not pruned"
+[ "$(date -r bin/gen.txt +%Y)" = "2000" ] || fail "unchanged output was rewritten: bin/gen.txt"
+[ "$(date -r "bin/it's gen.txt.stamp" +%Y)" = "2000" ] || fail "unchanged implicit output was rewritten"
+[ ! -e bin/gen.txt.oro-prev ] || fail "stale bin/gen.txt.oro-prev"
+[ ! -e bin/gen.txt.oro-cmd ] || fail "stale bin/gen.txt.oro-cmd"
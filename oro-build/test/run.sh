@@ -41,14 +41,38 @@ runtest builtin-fail
 runtest globals-type
 runtest globals-type-iscallable
 runtest globals-type-name
+runtest globals-freeze
 runtest globals-startswith
 runtest globals-endswith
 runtest globals-syscall
+runtest globals-executemany
+runtest globals-execute-pipes
 runtest globals-prefix
 runtest globals-norm-single
 runtest globals-norm-singleopt
 runtest globals-norm-singleinput
 runtest globals-norm-singleinputopt
 runtest path-basename
+runtest path-native
+runtest path-intern
 runtest syscall-init-depfile
+runtest syscall-with-depfile
+runtest syscall-cc-cache
+runtest syscall-cxx-modules-collate
+runtest cc-modules
+runtest cc-pch
+runtest cc-unity
+runtest cc-lto
+runtest cc-pgo
+runtest cc-compdb
 runtest syscall-cp
+runtest rule-writeifchanged
+runtest rule-batch
+runtest rule-pool
+runtest rule-intern
+runtest ninja-unchanged
+runtest module-cache
+runtest execute-cache
+runtest script-cache
+runtest profile
+runtest embed-lua
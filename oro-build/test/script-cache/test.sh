@@ -0,0 +1,10 @@
+mkdir -p bin
+./build.oro bin 2>bin/configure.log || (cat bin/configure.log; false)
+grep -q 'Script cache: 0 hit(s), 2 miss(es)' bin/configure.log || fail "expected cold script cache"
+./build.oro bin 2>bin/configure.log || (cat bin/configure.log; false)
+grep -q 'Script cache: 2 hit(s), 0 miss(es)' bin/configure.log || fail "expected warm script cache"
+for f in bin/.oro/cache/*.luac; do echo garbage > "$f"; done
+./build.oro bin 2>bin/configure.log || (cat bin/configure.log; false)
+grep -q 'Script cache: 0 hit(s), 2 miss(es)' bin/configure.log || fail "expected stale entries to be ignored"
+ninja -C bin
+[ -f bin/foo ] || fail "missing bin/foo"
@@ -0,0 +1,2 @@
+echo "$*" >> compile.log
+exec cc "$@"
@@ -0,0 +1 @@
+int launched(void) { return 1; }
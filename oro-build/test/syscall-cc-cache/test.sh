@@ -0,0 +1,45 @@
+mkdir -p bin/tools
+{ echo '#!/bin/sh'; cat cc.sh; } > bin/tools/oro-test-cc
+{ echo '#!/bin/sh'; sed 's/compile\.log/wrapped.log/' cc.sh; } > bin/tools/oro-test-wrapped-cc
+printf '#!/bin/sh\nexec "$@"\n' > bin/tools/oro-test-launcher
+chmod +x bin/tools/oro-test-cc bin/tools/oro-test-wrapped-cc bin/tools/oro-test-launcher
+export PATH="$PWD/bin/tools:$PATH"
+printf '#define VALUE 1\n' > value.h
+./build.oro bin
+ninja -C bin
+[ -f bin/main.o ] || fail 'not found: bin/main.o'
+grep -q 'value.h' bin/main.o.d || fail 'depfile is missing value.h'
+[ "$(grep -vc -- '-E' bin/compile.log)" = "1" ] || fail 'expected one compilation'
+cp bin/main.o bin/main.o.first
+# A removed object is restored from the cache (only preprocessed)
+rm bin/main.o bin/main.o.d
+ninja -C bin
+[ "$(grep -vc -- '-E' bin/compile.log)" = "1" ] || fail 'cache hit still compiled'
+cmp bin/main.o bin/main.o.first || fail 'restored object differs'
+grep -q 'value.h' bin/main.o.d || fail 'restored depfile is missing value.h'
+ninja -C bin -n | grep -q 'no work to do' || fail 'restored object is not up to date'
+# A header change is a miss
+printf '#define VALUE 2\n' > value.h
+ninja -C bin
+[ "$(grep -vc -- '-E' bin/compile.log)" = "2" ] || fail 'header change did not recompile'
+printf '#define VALUE 1\n' > value.h
+# Unrelated PATH changes are still hits
+rm bin/main.o
+PATH="/nonexistent:$PATH" ninja -C bin
+[ "$(grep -vc -- '-E' bin/compile.log)" = "2" ] || fail 'PATH change recompiled'
+# Upgrading the compiler (found via PATH) is a miss
+touch -d '2001-01-01 00:00:00' bin/tools/oro-test-cc
+rm bin/main.o
+ninja -C bin
+[ "$(grep -vc -- '-E' bin/compile.log)" = "3" ] || fail 'compiler upgrade did not recompile'
+# Compilers run through a launcher are cached too, and
+# upgrading them (rather than the launcher) is a miss
+[ "$(grep -vc -- '-E' bin/wrapped.log)" = "1" ] || fail 'expected one launched compilation'
+rm bin/launched.o
+ninja -C bin
+[ "$(grep -vc -- '-E' bin/wrapped.log)" = "1" ] || fail 'launched cache hit still compiled'
+touch -d '2001-01-01 00:00:00' bin/tools/oro-test-wrapped-cc
+rm bin/launched.o
+ninja -C bin
+[ "$(grep -vc -- '-E' bin/wrapped.log)" = "2" ] || fail 'wrapped compiler upgrade did not recompile'
+true
@@ -1,3 +1,6 @@
+mkdir -p bin
+echo one > bin/readonly.in
+chmod 444 bin/readonly.in
 ./build.oro bin
 rm -f bin/{empty,hello,multi}
 ninja -C bin
@@ -9,3 +12,24 @@ ninja -C bin
 (diff --color=always -c hello bin/hello) || fail "unexpected contents: bin/hello"
 (diff --color=always -c empty bin/multi/empty) || fail "unexpected contents: bin/multi/empty"
 (diff --color=always -c hello bin/multi/hello) || fail "unexpected contents: bin/multi/hello"
+[ "$(stat -c %a hello)" = "$(stat -c %a bin/hello)" ] || fail "mode not preserved: bin/hello"
+[ "$(stat -c %Y hello)" = "$(stat -c %Y bin/multi/hello)" ] || fail "mtime not preserved: bin/multi/hello"
+# Existing (longer) outputs must be truncated
+echo 'some much longer stale contents' > bin/hello
+echo 'some much longer stale contents' > bin/multi/hello
+touch -d '2000-01-01 00:00:00' bin/hello bin/multi/hello
+ninja -C bin
+(diff --color=always -c hello bin/hello) || fail "stale contents not truncated: bin/hello"
+(diff --color=always -c hello bin/multi/hello) || fail "stale contents not truncated: bin/multi/hello"
+# Identical outputs are left untouched (and pruned via restat)
+touch -d '2010-01-01 00:00:00' bin/hello
+ninja -C bin
+[ "$(date -r bin/hello +%Y)" = "2010" ] || fail "identical output was rewritten: bin/hello"
+ninja -C bin -n | grep -q 'no work to do' || fail "restat did not settle bin/hello"
+# Read-only sources give owner-writable outputs, which can be replaced
+[ "$(stat -c %a bin/readonly)" = 644 ] || fail "output not owner-writable: bin/readonly"
+chmod u+w bin/readonly.in
+echo two > bin/readonly.in
+chmod 444 bin/readonly.in
+ninja -C bin
+[ "$(cat bin/readonly)" = two ] || fail "read-only source not re-copied: bin/readonly"
@@ -0,0 +1,17 @@
+out="$1"
+modmap="$2"
+provides="${3:-}"
+
+tail -n +2 "$modmap" | while read -r name bmi; do
+	if [ "$name" != "$provides" ] && [ ! -f "$bmi" ]; then
+		echo "missing BMI: $bmi" >&2
+		exit 1
+	fi
+done || exit 1
+
+if [ -n "$provides" ]; then
+	mkdir -p bmi
+	touch "bmi/$provides.gcm"
+fi
+
+touch "$out"
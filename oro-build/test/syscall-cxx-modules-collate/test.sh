@@ -0,0 +1,19 @@
+./build.oro bin
+ninja -C bin
+[ -f bin/bmi/math.gcm ] || fail 'not found: bin/bmi/math.gcm'
+grep -q '^build main.o: dyndep | bmi/math.gcm$' bin/modules.dd || fail 'main.o does not import bmi/math.gcm'
+grep -q '^build math.o | bmi/math.gcm: dyndep$' bin/modules.dd || fail 'math.o does not provide bmi/math.gcm'
+(printf '$root .\nmath bmi/math.gcm\n' | diff --color=always -c - bin/main.o.modmap) || fail "unexpected contents: bin/main.o.modmap"
+ninja -C bin -n | grep -q 'no work to do' || fail 'edges are not up to date'
+# A new BMI rebuilds its importers
+touch bin/bmi/math.gcm
+ninja -C bin -n | grep -q 'main.o' || fail 'main.o is not rebuilt after its import changed'
+# Imports no scan provides are left to the compiler
+(cd bin && .oro/build --syscall cxx-modules-collate alone.dd bmi .gcm gcc -- alone.o ../main.ddi) || fail 'unprovided import was an error'
+grep -q '^build alone.o: dyndep$' bin/alone.dd || fail 'alone.o imports an unprovided module'
+(printf '$root .\n' | diff --color=always -c - bin/alone.o.modmap) || fail "unexpected contents: bin/alone.o.modmap"
+# ... or come from another target's scans
+(cd bin && .oro/build --syscall cxx-modules-collate other.dd bmi .gcm gcc -- other.o ../main.ddi -- lib ../math.ddi) || fail 'imported scan was not used'
+grep -q '^build other.o: dyndep | lib/math.gcm$' bin/other.dd || fail 'other.o does not import lib/math.gcm'
+(printf '$root .\nmath lib/math.gcm\n' | diff --color=always -c - bin/other.o.modmap) || fail "unexpected contents: bin/other.o.modmap"
+true
@@ -0,0 +1,2 @@
+printf '%s: %s\n' "$1" "$2" > "$1.d"
+cp "$2" "$1"
@@ -0,0 +1,14 @@
+./build.oro bin
+ninja -C bin
+[ -f bin/foo/bar ] || fail 'not found: bin/foo/bar'
+[ -f bin/copied ] || fail 'not found: bin/copied'
+(printf 'foo/bar:\n' | diff --color=always -c - bin/foo/bar.d) || fail "unexpected contents: bin/foo/bar.d"
+ninja -C bin -n | grep -q 'no work to do' || fail "edges are not up to date"
+# The command's own depfile wins
+touch -d '2000-01-01 00:00:00' bin/copied
+ninja -C bin
+(printf 'copied: ../input.txt\n' | diff --color=always -c - bin/copied.d) || fail "unexpected contents: bin/copied.d"
+(cd bin && .oro/build --syscall with-depfile foo/baz.d -- .oro/build --syscall pass) || fail "with-depfile did not pass"
+(printf 'foo/baz:\n' | diff --color=always -c - bin/foo/baz.d) || fail "unexpected contents: bin/foo/baz.d"
+(cd bin && .oro/build --syscall with-depfile foo/baz.d -- .oro/build --syscall fail) && fail "with-depfile did not propagate failure"
+true